@@ -0,0 +1,87 @@
+#ifndef OCL_ARENA_H
+#define OCL_ARENA_H
+
+#include <map>
+#include <mutex>
+#include <CL/cl.h>
+
+class oclDeviceArena;
+
+// Aligned byte range of an arena. Kernels receive it as base buffer plus offset.
+struct oclArenaRange
+{
+	oclDeviceArena* arena;
+	size_t offset;
+	size_t size;
+	// Real sub-buffer on OpenCL 1.1+ when the arena was created with useSubBuffers.
+	cl_mem subBuffer;
+
+	oclArenaRange() : arena(NULL), offset(0), size(0), subBuffer(NULL) {}
+	bool valid() const { return arena != NULL; }
+	// subBuffer if present, otherwise the arena's buffer.
+	cl_mem buffer() const;
+	// Offset relative to buffer(): 0 for sub-buffers.
+	size_t bufferOffset() const { return subBuffer ? 0 : offset; }
+};
+
+// One large cl_mem from which many small objects are suballocated, so that
+// thousands of tiny buffers don't each become their own driver object.
+// Ranges are allocated first fit from a free list that coalesces on free;
+// with no frees this degenerates to a bump allocator.
+class oclDeviceArena
+{
+public:
+	oclDeviceArena();
+	~oclDeviceArena();
+
+	// size is clamped to CL_DEVICE_MAX_MEM_ALLOC_SIZE. With useSubBuffers, ranges
+	// get a clCreateSubBuffer view when the device reports OpenCL 1.1 or newer.
+	bool create(cl_context context, cl_device_id device, size_t size,
+		cl_mem_flags flags = CL_MEM_READ_WRITE, bool useSubBuffers = false);
+	// Also releases the sub-buffers of ranges that were never freed.
+	void destroy();
+
+	// alignment 0 uses the device's CL_DEVICE_MEM_BASE_ADDR_ALIGN.
+	bool allocate(size_t size, oclArenaRange* range, size_t alignment = 0);
+	void free(oclArenaRange* range);
+	// Drops every allocation at once and releases their sub-buffers.
+	// Outstanding ranges become invalid.
+	void reset();
+
+	cl_mem buffer() const { return m_buffer; }
+	size_t capacity() const { return m_capacity; }
+	size_t bytesUsed() const;
+	size_t alignment() const { return m_alignment; }
+	bool usesSubBuffers() const { return m_useSubBuffers; }
+
+private:
+	oclDeviceArena(const oclDeviceArena&);
+	oclDeviceArena& operator=(const oclDeviceArena&);
+
+	void releaseSubBuffers();
+
+	cl_mem m_buffer;
+	cl_mem_flags m_flags;
+	size_t m_capacity;
+	size_t m_alignment;
+	size_t m_used;
+	bool m_useSubBuffers;
+	mutable std::mutex m_mutex;
+	// offset -> size of each free block
+	std::map<size_t, size_t> m_free;
+	// offset -> sub-buffer of each allocated range that has one
+	std::map<size_t, cl_mem> m_subBuffers;
+};
+
+// Sets range as kernel arguments index (buffer) and index + 1 (cl_uint offset
+// in units of elementSize), e.g. for "__global float* base, uint offset".
+// Returns CL_INVALID_VALUE if the offset is not a multiple of elementSize;
+// allocate with an alignment that is.
+cl_int oclSetArenaRangeArg(cl_kernel kernel, cl_uint index, const oclArenaRange& range, size_t elementSize = 1);
+
+cl_int oclWriteArenaRange(cl_command_queue queue, const oclArenaRange& range, size_t offset, size_t size,
+	const void* data, cl_bool blocking, cl_event* event = NULL);
+cl_int oclReadArenaRange(cl_command_queue queue, const oclArenaRange& range, size_t offset, size_t size,
+	void* data, cl_bool blocking, cl_event* event = NULL);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef OCL_BUFFER_POOL_H
+#define OCL_BUFFER_POOL_H
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <CL/cl.h>
+
+#define OCL_UTIL_POOL_DEFAULT_HIGH_WATER (64ULL * 1024 * 1024)
+
+struct oclBufferPoolStats
+{
+	cl_ulong acquires;
+	cl_ulong hits;
+	cl_ulong misses;
+	// Buffers released to the driver by trimming.
+	cl_ulong trimmed;
+	// Bytes sitting in free lists.
+	cl_ulong bytesCached;
+	// Bytes handed out and not yet returned.
+	cl_ulong bytesInUse;
+
+	double hitRate() const { return acquires ? (double)hits / (double)acquires : 0.0; }
+};
+
+// Recycles cl_mem buffers of one context. Requests are rounded up to size
+// classes of 2^k and 1.5 * 2^k bytes and served from per-class free lists.
+// Once more than highWaterBytes are cached, the least recently returned
+// buffers are released back to the driver.
+class oclBufferPool
+{
+public:
+	explicit oclBufferPool(cl_context context, cl_ulong highWaterBytes = OCL_UTIL_POOL_DEFAULT_HIGH_WATER);
+	// Releases cached buffers. Buffers still handed out stay valid and must be
+	// released by the caller with clReleaseMemObject.
+	~oclBufferPool();
+
+	// flags may not contain CL_MEM_USE_HOST_PTR or CL_MEM_COPY_HOST_PTR.
+	// The returned buffer may be larger than size.
+	cl_mem acquire(size_t size, cl_mem_flags flags = CL_MEM_READ_WRITE, cl_int* error = NULL);
+	// Returns a buffer obtained from acquire to its free list. Commands already
+	// enqueued may still use it, and the next acquire may hand it to another
+	// queue or the host. Pass the event of the last such command as inUseUntil
+	// (the pool retains it) and the buffer is not handed out again before it
+	// completes. Without an event, release only once those commands completed,
+	// or keep every user of the pool on one in-order queue.
+	void release(cl_mem buffer, cl_event inUseUntil = NULL);
+
+	// Releases cached buffers, oldest first, until at most targetBytes are cached.
+	void trim(cl_ulong targetBytes = 0);
+	void setHighWaterBytes(cl_ulong highWaterBytes);
+
+	oclBufferPoolStats stats() const;
+	cl_context context() const { return m_context; }
+
+	// Size actually allocated for a request of size bytes.
+	static size_t sizeClass(size_t size);
+
+private:
+	oclBufferPool(const oclBufferPool&);
+	oclBufferPool& operator=(const oclBufferPool&);
+
+	struct Key
+	{
+		cl_mem_flags flags;
+		size_t size;
+
+		Key() : flags(0), size(0) {}
+		Key(cl_mem_flags f, size_t s) : flags(f), size(s) {}
+		bool operator<(const Key& other) const
+		{
+			return flags < other.flags || (flags == other.flags && size < other.size);
+		}
+	};
+	struct CachedBuffer
+	{
+		Key key;
+		cl_mem buffer;
+		// Retained; the buffer is busy until it completes. NULL when idle.
+		cl_event inUseUntil;
+	};
+	typedef std::list<CachedBuffer> LruList;
+
+	void trimLocked(cl_ulong targetBytes);
+
+	cl_context m_context;
+	cl_ulong m_highWaterBytes;
+	mutable std::mutex m_mutex;
+
+	// Front is the least recently returned buffer.
+	LruList m_lru;
+	std::map< Key, std::vector<LruList::iterator> > m_freeLists;
+	std::unordered_map<cl_mem, Key> m_inUse;
+	oclBufferPoolStats m_stats;
+};
+
+// Process-wide pool for context, created on first use.
+oclBufferPool* oclGetBufferPool(cl_context context);
+// Destroys the pool of context, if any. Call before releasing the context.
+void oclReleaseBufferPool(cl_context context);
+
+#endif
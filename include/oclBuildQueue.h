@@ -0,0 +1,82 @@
+#ifndef OCL_BUILD_QUEUE_H
+#define OCL_BUILD_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <CL/cl.h>
+
+struct oclBuildState;
+class oclBuildPool;
+
+// Handle to a program build submitted to an oclBuildPool.
+class oclBuildFuture
+{
+public:
+	oclBuildFuture() {}
+
+	bool valid() const { return m_state != NULL; }
+	bool ready() const;
+	// Blocks until the build finished and returns CL_SUCCESS or the build error.
+	cl_int wait() const;
+	cl_program program() const;
+	const std::vector<cl_device_id>& devices() const;
+	// Build log captured for device when the build finished. Waits for the build.
+	std::string log(cl_device_id device) const;
+	// Prints the captured logs of all devices. Waits for the build.
+	void printLog() const;
+
+private:
+	friend class oclBuildPool;
+	explicit oclBuildFuture(const std::shared_ptr<oclBuildState>& state) : m_state(state) {}
+
+	std::shared_ptr<oclBuildState> m_state;
+};
+
+// Worker threads calling clBuildProgram. Each build passes a pfn_notify
+// callback; drivers that build asynchronously return immediately and free the
+// worker, drivers that don't simply occupy it until the build is done.
+class oclBuildPool
+{
+public:
+	// threadCount 0 uses the number of hardware threads.
+	explicit oclBuildPool(unsigned int threadCount = 0);
+	// Waits for all submitted builds to finish.
+	~oclBuildPool();
+
+	// Builds program for devices (all devices of the program if deviceCount is 0).
+	oclBuildFuture submit(cl_program program, const cl_device_id* devices, cl_uint deviceCount, const char* options);
+	// Submits one build per program with the same devices and options.
+	std::vector<oclBuildFuture> submit(const cl_program* programs, size_t programCount,
+		const cl_device_id* devices, cl_uint deviceCount, const char* options);
+
+	// Blocks until every build submitted so far has finished.
+	void waitAll();
+
+private:
+	oclBuildPool(const oclBuildPool&);
+	oclBuildPool& operator=(const oclBuildPool&);
+
+	friend struct oclBuildState;
+	void workerLoop();
+	void buildFinished();
+
+	std::vector<std::thread> m_workers;
+	std::deque< std::shared_ptr<oclBuildState> > m_pending;
+	std::mutex m_mutex;
+	std::condition_variable m_workAvailable;
+	std::condition_variable m_idle;
+	size_t m_outstanding;
+	bool m_stopping;
+};
+
+// Process-wide pool sized to the hardware thread count.
+oclBuildPool* oclGetDefaultBuildPool();
+
+oclBuildFuture oclBuildProgramAsync(cl_program program, const cl_device_id* devices, cl_uint deviceCount, const char* options);
+
+#endif
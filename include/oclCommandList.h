@@ -0,0 +1,142 @@
+#ifndef OCL_COMMAND_LIST_H
+#define OCL_COMMAND_LIST_H
+
+#include <string>
+#include <vector>
+#include <CL/cl.h>
+
+// Sequence of kernel launches and transfers recorded once and replayed every
+// frame. Argument writes are recorded in sequence with the launches, so a
+// kernel can be launched several times with different arguments. Arguments
+// that change per frame are bound to named parameters. The list remembers
+// what it last set on each kernel argument, and replay only calls
+// clSetKernelArg when the value differs. Replay does no lookups or allocations.
+//
+//   oclCommandList list;
+//   int time = list.parameter("time", sizeof(cl_float));
+//   list.recordArg(kernel, 0, sizeof(cl_mem), &buffer);
+//   list.recordArgParameter(kernel, 1, time);
+//   list.recordKernel(kernel, 1, &global);
+//   for(;;) { list.set(time, t); list.replay(queue); }
+//
+// Kernels used by a list must not have their arguments changed elsewhere;
+// call invalidate() if they are. Not thread safe.
+class oclCommandList
+{
+public:
+	oclCommandList();
+
+	// Declares a named parameter of size bytes and returns its id; declaring
+	// an existing name returns the existing id. Returns -1 for size 0 or when
+	// name already exists with a different size.
+	int parameter(const char* name, size_t size);
+	// Id of name, or -1.
+	int find(const char* name) const;
+
+	// Set right away too, so the driver validates it once.
+	cl_int recordArg(cl_kernel kernel, cl_uint index, size_t size, const void* value);
+	// Sets argument index of kernel to the value parameter has at replay.
+	cl_int recordArgParameter(cl_kernel kernel, cl_uint index, int parameter);
+	cl_int recordKernel(cl_kernel kernel, cl_uint workDim, const size_t* globalWorkSize,
+		const size_t* localWorkSize = NULL);
+	// data must stay valid for as long as the list is replayed.
+	cl_int recordWrite(cl_mem buffer, size_t offset, size_t size, const void* data);
+	cl_int recordRead(cl_mem buffer, size_t offset, size_t size, void* data);
+	// Host pointer taken from a parameter of sizeof(void*), set with setPointer.
+	cl_int recordWriteParameter(cl_mem buffer, size_t offset, size_t size, int pointerParameter);
+	cl_int recordReadParameter(cl_mem buffer, size_t offset, size_t size, int pointerParameter);
+	cl_int recordCopy(cl_mem source, size_t sourceOffset, cl_mem destination, size_t destinationOffset, size_t size);
+
+	cl_int set(int parameter, const void* value, size_t size);
+	template<typename T>
+	cl_int set(int parameter, const T& value) { return set(parameter, &value, sizeof(T)); }
+	cl_int setPointer(int parameter, const void* pointer) { return set(parameter, &pointer, sizeof(pointer)); }
+
+	// Submits the recorded commands to queue, which should be in-order.
+	// waitList applies to the first enqueued command and event receives the last one.
+	// Transfers are non-blocking: wait for event before using read results.
+	// Returns CL_INVALID_KERNEL_ARGS, without enqueueing anything, while a
+	// parameter bound to a kernel argument has never been set.
+	cl_int replay(cl_command_queue queue, cl_uint waitCount = 0, const cl_event* waitList = NULL,
+		cl_event* event = NULL);
+
+	// Forgets the argument values the list set, so the next replay sets every
+	// recorded argument again.
+	void invalidate();
+	// Drops commands and parameters.
+	void clear();
+
+	size_t commandCount() const { return m_commands.size(); }
+	size_t parameterCount() const { return m_parameters.size(); }
+
+private:
+	enum CommandType
+	{
+		CommandKernel,
+		CommandWrite,
+		CommandRead,
+		CommandCopy,
+		CommandArg
+	};
+
+	struct Command
+	{
+		CommandType type;
+		cl_kernel kernel;
+		cl_uint workDim;
+		size_t globalWorkSize[3];
+		size_t localWorkSize[3];
+		bool hasLocalWorkSize;
+		cl_mem buffer;
+		cl_mem destination;
+		size_t offset;
+		size_t destinationOffset;
+		size_t size;
+		const void* source;
+		void* target;
+		// Parameter holding the host pointer, or -1.
+		int pointerParameter;
+		// CommandArg: the argument it writes, and its value from either a
+		// constant or a parameter (the other is -1).
+		int arg;
+		int constant;
+		int valueParameter;
+	};
+
+	struct Parameter
+	{
+		std::string name;
+		std::vector<unsigned char> value;
+		bool assigned;
+	};
+
+	struct ArgValue
+	{
+		std::vector<unsigned char> value;
+		// A NULL value, e.g. __local memory of size bytes.
+		bool null;
+	};
+
+	// What the list last set on one kernel argument.
+	struct ArgState
+	{
+		cl_kernel kernel;
+		cl_uint index;
+		ArgValue current;
+		// Cleared by invalidate() and failed sets.
+		bool known;
+	};
+
+	const void* pointerOf(const Command& command) const;
+	int argState(cl_kernel kernel, cl_uint index, size_t size);
+	cl_int applyArg(const Command& command);
+
+	std::vector<Command> m_commands;
+	std::vector<Parameter> m_parameters;
+	std::vector<ArgValue> m_constants;
+	std::vector<ArgState> m_args;
+	// Commands that are enqueued rather than argument writes.
+	size_t m_enqueuedCount;
+};
+
+#endif
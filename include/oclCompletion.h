@@ -0,0 +1,93 @@
+#ifndef OCL_COMPLETION_H
+#define OCL_COMPLETION_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <CL/cl.h>
+
+// Polling interval bounds of the fallback thread, in microseconds. The
+// interval doubles while nothing completes and drops back to the minimum
+// whenever an event completes or a new one is registered.
+#ifndef OCL_UTIL_COMPLETION_MIN_POLL_US
+#define OCL_UTIL_COMPLETION_MIN_POLL_US 20
+#endif
+#ifndef OCL_UTIL_COMPLETION_MAX_POLL_US
+#define OCL_UTIL_COMPLETION_MAX_POLL_US 2000
+#endif
+
+// Receives CL_COMPLETE, or the negative error the command terminated with.
+// int rather than cl_int, which would carry ignored attributes as a template argument.
+typedef std::function<void(int)> oclCompletionCallback;
+
+struct oclCompletionStats
+{
+	// Events handed to clSetEventCallback.
+	unsigned long long callbacks;
+	// Events watched by the polling thread.
+	unsigned long long polled;
+	// Status queries made by the polling thread.
+	unsigned long long polls;
+};
+
+// Turns cl_events into futures and continuations so the host thread can keep
+// preparing work instead of blocking in clWaitForEvents or clFinish.
+// Events of OpenCL 1.1+ devices are handed to clSetEventCallback; the others
+// are watched by a single polling thread, started on first use.
+// Continuations run on a driver thread or the polling thread: keep them short
+// and don't call blocking OpenCL functions from them. Exceptions thrown by a
+// continuation are caught and dropped.
+class oclCompletionService
+{
+public:
+	oclCompletionService();
+	~oclCompletionService();
+
+	// Calls continuation once event has completed. The event is retained until
+	// then and its queue is flushed. Returns false for invalid events.
+	bool then(cl_event event, const oclCompletionCallback& continuation);
+	// Future receiving the completion status of event. Invalid events yield
+	// CL_INVALID_EVENT right away.
+	std::future<int> future(cl_event event);
+
+	// Waits until every registered continuation has run.
+	void drain();
+
+	size_t outstanding() const;
+	oclCompletionStats stats() const;
+
+private:
+	oclCompletionService(const oclCompletionService&);
+	oclCompletionService& operator=(const oclCompletionService&);
+	friend struct oclCompletionCallbacks;
+
+	struct Pending
+	{
+		cl_event event;
+		oclCompletionCallback continuation;
+	};
+
+	bool useCallback(cl_event event) const;
+	void pollLoop();
+	void retire(size_t count);
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_work;
+	std::condition_variable m_drained;
+	// Registered since the polling thread last looked.
+	std::vector<Pending> m_incoming;
+	std::thread m_pollThread;
+	bool m_stopping;
+	size_t m_outstanding;
+	oclCompletionStats m_stats;
+};
+
+// Process wide service, created on first use.
+oclCompletionService* oclGetCompletionService();
+// Drains and destroys the process wide service, stopping the polling thread.
+void oclReleaseCompletionService();
+
+#endif
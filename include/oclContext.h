@@ -0,0 +1,42 @@
+#ifndef OCL_CONTEXT_H
+#define OCL_CONTEXT_H
+
+#include <vector>
+#include <CL/cl.h>
+
+// A single cl_context spanning several devices of one platform, with one
+// in-order command queue per device. Programs and buffers created on
+// context are shared by all devices.
+struct oclContext
+{
+	cl_context context;
+	cl_platform_id platform;
+	std::vector<cl_device_id> devices;
+	// queues[i] belongs to devices[i]
+	std::vector<cl_command_queue> queues;
+
+	oclContext() : context(NULL), platform(NULL) {}
+	~oclContext();
+
+	cl_uint deviceCount() const { return (cl_uint)devices.size(); }
+	// Returns NULL if device is not part of the context.
+	cl_command_queue queueFor(cl_device_id device) const;
+
+private:
+	oclContext(const oclContext&);
+	oclContext& operator=(const oclContext&);
+};
+
+// Creates a context over every device of deviceType on platformId,
+// e.g. CL_DEVICE_TYPE_CPU | CL_DEVICE_TYPE_GPU.
+bool oclCreateMultiDeviceContext(oclContext* context, cl_platform_id platformId,
+	cl_device_type deviceType = CL_DEVICE_TYPE_ALL, cl_command_queue_properties queueProperties = 0);
+
+// Creates a context over an explicit device list; all devices must belong to platformId.
+bool oclCreateMultiDeviceContext(oclContext* context, cl_platform_id platformId,
+	const cl_device_id* devices, cl_uint deviceCount, cl_command_queue_properties queueProperties = 0);
+
+// Releases the queues and the context. Called by ~oclContext.
+void oclReleaseContext(oclContext* context);
+
+#endif
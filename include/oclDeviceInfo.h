@@ -0,0 +1,66 @@
+#ifndef OCL_DEVICE_INFO_H
+#define OCL_DEVICE_INFO_H
+
+#include <string>
+#include <CL/cl.h>
+
+// Snapshot of the clGetDeviceInfo parameters used by oclUtil.
+// Filled once per cl_device_id and cached for the lifetime of the process.
+struct oclDeviceInfo
+{
+	cl_device_id device;
+	cl_platform_id platform;
+
+	std::string name;
+	std::string vendor;
+	std::string driverVersion;
+	std::string deviceVersion;
+	std::string openclCVersion;
+	std::string extensions;
+
+	// Parsed from deviceVersion ("OpenCL <major>.<minor> ...")
+	int versionMajor;
+	int versionMinor;
+
+	cl_device_type type;
+	cl_uint computeUnits;
+	cl_uint maxWorkItemDimensions;
+	size_t maxWorkItemSizes[3];
+	size_t maxWorkGroupSize;
+	cl_uint maxClockFrequency;
+	cl_uint addressBits;
+	cl_uint memBaseAddrAlign;
+	cl_ulong maxMemAllocSize;
+	cl_ulong globalMemSize;
+	cl_bool errorCorrectionSupport;
+	// CL_DEVICE_HOST_UNIFIED_MEMORY, only reported by 1.1+ devices.
+	cl_bool hostUnifiedMemory;
+	cl_device_local_mem_type localMemType;
+	cl_ulong localMemSize;
+	cl_ulong maxConstantBufferSize;
+	cl_command_queue_properties queueProperties;
+	cl_bool imageSupport;
+	cl_uint maxReadImageArgs;
+	cl_uint maxWriteImageArgs;
+	cl_device_fp_config singleFpConfig;
+	size_t image2dMaxWidth;
+	size_t image2dMaxHeight;
+	size_t image3dMaxWidth;
+	size_t image3dMaxHeight;
+	size_t image3dMaxDepth;
+	// CHAR, SHORT, INT, LONG, FLOAT, DOUBLE
+	cl_uint preferredVectorWidth[6];
+
+	// Exact match against the space delimited extension list.
+	bool hasExtension(const char* extension) const;
+	bool versionAtLeast(int major, int minor) const;
+	// CPU devices and devices reporting unified host memory, where
+	// CL_MEM_USE_HOST_PTR buffers avoid any copy.
+	bool sharesHostMemory() const;
+};
+
+// Returns the cached snapshot for device, querying the driver on first use.
+// Returns NULL if the device could not be queried.
+const oclDeviceInfo* oclGetDeviceInfo(cl_device_id device);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef OCL_DEVICE_SELECT_H
+#define OCL_DEVICE_SELECT_H
+
+#include <vector>
+#include <CL/cl.h>
+#include <oclDeviceInfo.h>
+
+// Name of the environment variable that overrides device selection.
+// Accepted values:
+//   "gpu", "cpu", "accelerator"  only consider devices of that type
+//   "<platform>:<device>"        pick by enumeration index, e.g. "0:1"
+//   any other string             prefer devices whose device or platform name contains it
+#define OCL_UTIL_DEVICE_ENV "OCL_UTIL_DEVICE"
+
+struct oclDeviceSelectOptions
+{
+	// Device types considered at all.
+	cl_device_type deviceTypes;
+	// Device types ranked ahead of the rest; the others are kept as fallback.
+	cl_device_type preferredTypes;
+	// Space separated extensions a device must report, or NULL.
+	const char* requiredExtensions;
+	// Replace the compute units x clock estimate with a short measured kernel.
+	// Each device is measured once per process.
+	bool runBenchmark;
+	// Honour OCL_UTIL_DEVICE_ENV.
+	bool allowEnvironmentOverride;
+
+	oclDeviceSelectOptions()
+		: deviceTypes(CL_DEVICE_TYPE_ALL)
+		, preferredTypes(CL_DEVICE_TYPE_GPU)
+		, requiredExtensions(NULL)
+		, runBenchmark(false)
+		, allowEnvironmentOverride(true)
+	{}
+};
+
+struct oclDeviceCandidate
+{
+	cl_platform_id platform;
+	cl_device_id device;
+	const oclDeviceInfo* info;
+	cl_uint platformIndex;
+	cl_uint deviceIndex;
+	// Estimated (or measured) single precision GFLOP/s.
+	double throughput;
+	// Throughput weighted by memory capacity; candidates are sorted on this.
+	double score;
+};
+
+// Enumerates every platform x device, drops devices missing required extensions
+// and returns the rest ranked best first. Returns false if nothing qualifies.
+bool oclRankDevices(std::vector<oclDeviceCandidate>* ranked, const oclDeviceSelectOptions* options = NULL);
+
+// Single precision GFLOP/s of device: the compute units x clock estimate, or
+// with measure the result of the benchmark kernel, cached per device.
+double oclGetDeviceThroughput(cl_device_id device, bool measure = false);
+
+// Picks the best ranked device.
+bool oclSelectDevice(cl_platform_id* platformId, cl_device_id* deviceId, const oclDeviceSelectOptions* options = NULL);
+
+void oclPrintDeviceRanking(const std::vector<oclDeviceCandidate>& ranked);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef OCL_HANDLES_H
+#define OCL_HANDLES_H
+
+#include <CL/cl.h>
+
+namespace ocl
+{
+
+template<typename T> struct HandleTraits;
+
+#define OCL_UTIL_HANDLE_TRAITS(type, retainFunction, releaseFunction) \
+	template<> struct HandleTraits<type> \
+	{ \
+		static cl_int retain(type handle) { return retainFunction(handle); } \
+		static cl_int release(type handle) { return releaseFunction(handle); } \
+	};
+
+OCL_UTIL_HANDLE_TRAITS(cl_context, clRetainContext, clReleaseContext)
+OCL_UTIL_HANDLE_TRAITS(cl_command_queue, clRetainCommandQueue, clReleaseCommandQueue)
+OCL_UTIL_HANDLE_TRAITS(cl_program, clRetainProgram, clReleaseProgram)
+OCL_UTIL_HANDLE_TRAITS(cl_kernel, clRetainKernel, clReleaseKernel)
+OCL_UTIL_HANDLE_TRAITS(cl_mem, clRetainMemObject, clReleaseMemObject)
+OCL_UTIL_HANDLE_TRAITS(cl_event, clRetainEvent, clReleaseEvent)
+OCL_UTIL_HANDLE_TRAITS(cl_sampler, clRetainSampler, clReleaseSampler)
+
+#undef OCL_UTIL_HANDLE_TRAITS
+
+// Move-only owner of one OpenCL reference. Moving transfers the reference
+// without touching the refcount; the only retain is the explicit share().
+// Converts implicitly to the raw handle so it can be passed straight to cl* calls.
+template<typename T>
+class Handle
+{
+public:
+	Handle() : m_handle(NULL) {}
+	// Takes ownership of a reference the caller already holds (e.g. from clCreate*).
+	explicit Handle(T handle) : m_handle(handle) {}
+	~Handle() { reset(); }
+
+	// noexcept so std::vector moves handles instead of failing to copy them on growth.
+	Handle(Handle&& other) noexcept : m_handle(other.m_handle) { other.m_handle = NULL; }
+	Handle& operator=(Handle&& other) noexcept
+	{
+		if(this != &other)
+		{
+			reset();
+			m_handle = other.m_handle;
+			other.m_handle = NULL;
+		}
+		return *this;
+	}
+
+	Handle(const Handle&) = delete;
+	Handle& operator=(const Handle&) = delete;
+
+	// Retains handle and returns a second owner of it.
+	static Handle retain(T handle)
+	{
+		if(handle != NULL)
+			HandleTraits<T>::retain(handle);
+		return Handle(handle);
+	}
+	Handle share() const { return retain(m_handle); }
+
+	T get() const { return m_handle; }
+	operator T() const { return m_handle; }
+	explicit operator bool() const { return m_handle != NULL; }
+
+	// Gives up ownership without releasing.
+	T detach()
+	{
+		T handle = m_handle;
+		m_handle = NULL;
+		return handle;
+	}
+
+	void reset(T handle = NULL)
+	{
+		if(m_handle != NULL)
+			HandleTraits<T>::release(m_handle);
+		m_handle = handle;
+	}
+
+	// Releases the current handle and returns its address for use as an
+	// out-parameter, e.g. clEnqueueNDRangeKernel(..., event.out()).
+	T* out()
+	{
+		reset();
+		return &m_handle;
+	}
+
+private:
+	T m_handle;
+};
+
+typedef Handle<cl_context> Context;
+typedef Handle<cl_command_queue> Queue;
+typedef Handle<cl_program> Program;
+typedef Handle<cl_kernel> Kernel;
+typedef Handle<cl_mem> Buffer;
+typedef Handle<cl_event> Event;
+typedef Handle<cl_sampler> Sampler;
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef OCL_HOST_ALLOC_H
+#define OCL_HOST_ALLOC_H
+
+#include <CL/cl.h>
+
+// Flags for oclHostAlloc.
+#define OCL_UTIL_HOST_ALLOC_HUGE_PAGES 0x1
+
+// How many misaligned transfers are reported before oclCheckHostPtr goes quiet.
+#ifndef OCL_UTIL_MISALIGNED_WARNINGS
+#define OCL_UTIL_MISALIGNED_WARNINGS 8
+#endif
+
+struct oclHostAlignmentStats
+{
+	// Pointers checked by oclCheckHostPtr.
+	cl_ulong checks;
+	// Checks that found a pointer below the device's alignment.
+	cl_ulong misaligned;
+	cl_ulong misalignedBytes;
+};
+
+size_t oclPageSize();
+// Size of a huge page, or 0 when the system has none.
+size_t oclHugePageSize();
+// Alignment that lets device use host memory in place and DMA from it:
+// the page size or CL_DEVICE_MEM_BASE_ADDR_ALIGN, whichever is larger.
+size_t oclHostAlignment(cl_device_id device);
+
+// Allocates size bytes aligned to alignment (0 means the page size), rounded
+// up to a whole number of alignment units. With OCL_UTIL_HOST_ALLOC_HUGE_PAGES
+// large allocations are backed by huge pages where the system allows it and
+// silently fall back to normal pages otherwise. Free with oclHostFree.
+void* oclHostAlloc(size_t size, size_t alignment = 0, unsigned int flags = 0);
+// Allocation aligned for device, suitable for CL_MEM_USE_HOST_PTR.
+void* oclHostAllocForDevice(cl_device_id device, size_t size, unsigned int flags = 0);
+// Resizes an oclHostAlloc block, keeping its alignment and flags. Like
+// realloc, the contents up to the smaller size are preserved and size 0 frees.
+void* oclHostRealloc(void* memory, size_t size);
+void oclHostFree(void* memory);
+// Usable size of an oclHostAlloc block, 0 for foreign pointers.
+size_t oclHostAllocSize(const void* memory);
+
+// Checks ptr against CL_DEVICE_MEM_BASE_ADDR_ALIGN, the alignment the runtime
+// needs to DMA from a host pointer or use it in place.
+bool oclIsHostPtrAligned(const void* ptr, cl_device_id device);
+// Counts ptr against the alignment of queue's device and warns (the first
+// OCL_UTIL_MISALIGNED_WARNINGS times) when the runtime will likely stage the
+// transfer through an extra copy. Returns whether ptr was aligned.
+bool oclCheckHostPtr(cl_command_queue queue, const void* ptr, size_t size, const char* action);
+oclHostAlignmentStats oclGetHostAlignmentStats();
+void oclResetHostAlignmentStats();
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef OCL_HOST_BUFFER_H
+#define OCL_HOST_BUFFER_H
+
+#include <CL/cl.h>
+
+// Buffer that avoids copies on devices sharing host memory. On CPU and
+// unified-memory devices it wraps page-aligned host memory with
+// CL_MEM_USE_HOST_PTR and mapping returns that memory directly; on discrete
+// devices it is an ordinary device buffer and map/read/write copy.
+struct oclHostBuffer
+{
+	cl_mem buffer;
+	// Backing host memory for zero-copy buffers, NULL otherwise.
+	void* host;
+	size_t size;
+	bool zeroCopy;
+
+	oclHostBuffer() : buffer(NULL), host(NULL), size(0), zeroCopy(false) {}
+};
+
+// flags are the access flags (CL_MEM_READ_WRITE etc.); host pointer flags are chosen here.
+bool oclCreateHostBuffer(cl_context context, cl_device_id device, size_t size, cl_mem_flags flags, oclHostBuffer* buffer);
+// The caller must make sure no commands using the buffer are still running.
+void oclReleaseHostBuffer(oclHostBuffer* buffer);
+
+// Blocking map. For zero-copy buffers this returns host + offset without a copy.
+void* oclMapHostBuffer(cl_command_queue queue, const oclHostBuffer& buffer, cl_map_flags flags,
+	size_t offset, size_t size, cl_int* error = NULL);
+cl_int oclUnmapHostBuffer(cl_command_queue queue, const oclHostBuffer& buffer, void* mapped, cl_event* event = NULL);
+
+cl_int oclWriteHostBuffer(cl_command_queue queue, const oclHostBuffer& buffer, size_t offset, size_t size,
+	const void* data, cl_bool blocking, cl_event* event = NULL);
+cl_int oclReadHostBuffer(cl_command_queue queue, const oclHostBuffer& buffer, size_t offset, size_t size,
+	void* data, cl_bool blocking, cl_event* event = NULL);
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef OCL_IMAGE_POOL_H
+#define OCL_IMAGE_POOL_H
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <CL/cl.h>
+#include <oclHandles.h>
+
+#define OCL_UTIL_IMAGE_POOL_DEFAULT_HIGH_WATER (256ULL * 1024 * 1024)
+
+// clGetSupportedImageFormats for context, queried once per (flags, imageType)
+// and cached until oclReleaseImageFormats. imageType is CL_MEM_OBJECT_IMAGE2D
+// or CL_MEM_OBJECT_IMAGE3D. Returns an empty list when images are unsupported.
+const std::vector<cl_image_format>& oclGetImageFormats(cl_context context, cl_mem_flags flags,
+	cl_mem_object_type imageType);
+bool oclIsImageFormatSupported(cl_context context, cl_mem_flags flags, cl_mem_object_type imageType,
+	const cl_image_format& format);
+// Drops the cached tables of context. Call before releasing the context.
+void oclReleaseImageFormats(cl_context context);
+
+// Bytes per pixel of format, 0 for unknown orders or types.
+size_t oclImageFormatSize(const cl_image_format& format);
+
+struct oclImagePoolStats
+{
+	cl_ulong acquires;
+	cl_ulong hits;
+	cl_ulong misses;
+	// Images released to the driver by trimming.
+	cl_ulong trimmed;
+	// Estimated bytes sitting in free lists.
+	cl_ulong bytesCached;
+	// Estimated bytes handed out and not yet returned.
+	cl_ulong bytesInUse;
+
+	double hitRate() const { return acquires ? (double)hits / (double)acquires : 0.0; }
+};
+
+// Recycles 2D and 3D images of one context. Unlike buffers, images only match
+// exactly, so free lists are keyed by (flags, format, width, height, depth).
+// Once more than highWaterBytes are cached, the least recently returned
+// images are released, which drops stale sizes after a resolution change.
+class oclImagePool
+{
+public:
+	explicit oclImagePool(cl_context context, cl_ulong highWaterBytes = OCL_UTIL_IMAGE_POOL_DEFAULT_HIGH_WATER);
+	// Releases cached images. Images still handed out stay valid and must be
+	// released by the caller with clReleaseMemObject.
+	~oclImagePool();
+
+	// depth 0 creates a 2D image. Unsupported formats fail with
+	// CL_IMAGE_FORMAT_NOT_SUPPORTED without calling the driver.
+	cl_mem acquire(const cl_image_format& format, size_t width, size_t height, size_t depth = 0,
+		cl_mem_flags flags = CL_MEM_READ_WRITE, cl_int* error = NULL);
+	// Returns an image obtained from acquire to its free list. As with
+	// oclBufferPool::release, pass the event of the last command still using
+	// the image, or release only once those commands completed; otherwise the
+	// next acquire may hand it out while it is being read or written.
+	void release(cl_mem image, cl_event inUseUntil = NULL);
+
+	// Releases cached images, oldest first, until at most targetBytes are cached.
+	void trim(cl_ulong targetBytes = 0);
+	void setHighWaterBytes(cl_ulong highWaterBytes);
+
+	oclImagePoolStats stats() const;
+	cl_context context() const { return m_context; }
+
+private:
+	oclImagePool(const oclImagePool&);
+	oclImagePool& operator=(const oclImagePool&);
+
+	struct Key
+	{
+		cl_mem_flags flags;
+		cl_uint order;
+		cl_uint type;
+		size_t width;
+		size_t height;
+		size_t depth;
+
+		bool operator<(const Key& other) const;
+		cl_ulong bytes() const;
+	};
+	struct CachedImage
+	{
+		Key key;
+		ocl::Buffer image;
+		// The image is busy until it completes. Empty when idle.
+		ocl::Event inUseUntil;
+	};
+	typedef std::list<CachedImage> LruList;
+
+	void trimLocked(cl_ulong targetBytes);
+
+	ocl::Context m_context;
+	cl_ulong m_highWaterBytes;
+	mutable std::mutex m_mutex;
+
+	// Front is the least recently returned image.
+	LruList m_lru;
+	std::map< Key, std::vector<LruList::iterator> > m_freeLists;
+	std::unordered_map<cl_mem, Key> m_inUse;
+	oclImagePoolStats m_stats;
+};
+
+// Process-wide pool for context, created on first use.
+oclImagePool* oclGetImagePool(cl_context context);
+// Destroys the pool of context, if any, and its cached format tables.
+// Call before releasing the context.
+void oclReleaseImagePool(cl_context context);
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef OCL_KERNEL_VARIANTS_H
+#define OCL_KERNEL_VARIANTS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <CL/cl.h>
+#include <oclUtil.h>
+
+// OpenCL C spelling of a host type, used to specialise kernels on data types.
+template<typename T> struct oclTypeName;
+
+#define OCL_UTIL_TYPE_NAME(type, clName) \
+	template<> struct oclTypeName<type> { static const char* name() { return clName; } };
+
+// Scalars are specialised on the plain C++ types because the cl_* scalar
+// typedefs carry alignment attributes that are dropped in template arguments.
+// Plain char is distinct from both signed and unsigned char.
+OCL_UTIL_TYPE_NAME(char, "char")
+OCL_UTIL_TYPE_NAME(int8_t, "char")
+OCL_UTIL_TYPE_NAME(uint8_t, "uchar")
+OCL_UTIL_TYPE_NAME(int16_t, "short")
+OCL_UTIL_TYPE_NAME(uint16_t, "ushort")
+OCL_UTIL_TYPE_NAME(int32_t, "int")
+OCL_UTIL_TYPE_NAME(uint32_t, "uint")
+OCL_UTIL_TYPE_NAME(int64_t, "long")
+OCL_UTIL_TYPE_NAME(uint64_t, "ulong")
+OCL_UTIL_TYPE_NAME(float, "float")
+OCL_UTIL_TYPE_NAME(double, "double")
+
+#define OCL_UTIL_VECTOR_TYPE_NAMES(base) \
+	OCL_UTIL_TYPE_NAME(cl_##base##2, #base "2") \
+	OCL_UTIL_TYPE_NAME(cl_##base##4, #base "4") \
+	OCL_UTIL_TYPE_NAME(cl_##base##8, #base "8") \
+	OCL_UTIL_TYPE_NAME(cl_##base##16, #base "16")
+
+OCL_UTIL_VECTOR_TYPE_NAMES(char)
+OCL_UTIL_VECTOR_TYPE_NAMES(uchar)
+OCL_UTIL_VECTOR_TYPE_NAMES(short)
+OCL_UTIL_VECTOR_TYPE_NAMES(ushort)
+OCL_UTIL_VECTOR_TYPE_NAMES(int)
+OCL_UTIL_VECTOR_TYPE_NAMES(uint)
+OCL_UTIL_VECTOR_TYPE_NAMES(long)
+OCL_UTIL_VECTOR_TYPE_NAMES(ulong)
+OCL_UTIL_VECTOR_TYPE_NAMES(float)
+OCL_UTIL_VECTOR_TYPE_NAMES(double)
+
+#undef OCL_UTIL_VECTOR_TYPE_NAMES
+
+// Ordered list of NAME=value constants a kernel is specialised on.
+class oclSpecialization
+{
+public:
+	oclSpecialization& define(const std::string& name, const std::string& value);
+	oclSpecialization& define(const std::string& name, long long value);
+	template<typename T> oclSpecialization& defineType(const std::string& name)
+	{
+		return define(name, oclTypeName<T>::name());
+	}
+
+	// Identifies the specialisation, e.g. "T=float4;TILE=16;"
+	const std::string& key() const { return m_key; }
+	// "-D NAME=value ..." appended to baseOptions.
+	std::string buildOptions(const char* baseOptions) const;
+	// "#define NAME value" lines to prepend to the source.
+	std::string defineBlock() const;
+
+private:
+	std::vector< std::pair<std::string, std::string> > m_defines;
+	std::string m_key;
+};
+
+enum oclVariantMode
+{
+	// Pass the constants as -D build options.
+	OCL_VARIANT_BUILD_OPTIONS,
+	// Prepend #define lines to the source, for values the option parser can't take.
+	OCL_VARIANT_PREPENDED_DEFINES
+};
+
+// Builds and caches one cl_kernel per specialisation of a kernel source.
+// Programs are built through the program binary cache.
+class oclKernelVariants
+{
+public:
+	// parameterNames names the template arguments of variant<>(), in order.
+	oclKernelVariants(cl_context context, cl_device_id device, const char* filename, const char* kernelName,
+		const std::vector<std::string>& parameterNames = std::vector<std::string>(),
+		const char* baseOptions = NULL, oclVariantMode mode = OCL_VARIANT_BUILD_OPTIONS);
+	~oclKernelVariants();
+
+	bool sourceLoaded() const { return m_sourceLoaded; }
+
+	// Returns the kernel for spec, building it on first use. The kernel is owned by this object.
+	// Builds run without holding the lock, so other variants are served meanwhile;
+	// concurrent requests for a variant being built wait for that build.
+	// A failed build is remembered, later requests for spec fail with its error.
+	cl_kernel get(const oclSpecialization& spec, cl_int* error = NULL);
+
+	// variant<cl_float4, 16, 16>() binds the type to the first parameter name
+	// and the integers to the following ones. Fails with CL_INVALID_VALUE unless
+	// there is exactly one template argument per parameter name.
+	template<typename T, long long... Values>
+	cl_kernel variant(cl_int* error = NULL)
+	{
+		if(m_parameterNames.size() != sizeof...(Values) + 1)
+		{
+			if(oclGetVerbosity() > 0)
+				printf("%s takes %u template arguments, got %u\n", m_kernelName.c_str(),
+				(unsigned int)m_parameterNames.size(), (unsigned int)sizeof...(Values) + 1);
+			if(error != NULL)
+				*error = CL_INVALID_VALUE;
+			return NULL;
+		}
+
+		oclSpecialization spec;
+		spec.defineType<T>(m_parameterNames[0]);
+		const long long values[] = { Values..., 0 };
+		for(size_t i = 0; i < sizeof...(Values); i++)
+			spec.define(m_parameterNames[i + 1], values[i]);
+		return get(spec, error);
+	}
+
+	size_t variantCount() const;
+
+private:
+	oclKernelVariants(const oclKernelVariants&);
+	oclKernelVariants& operator=(const oclKernelVariants&);
+
+	struct Variant
+	{
+		cl_program program;
+		cl_kernel kernel;
+		// Placeholder while one thread builds the variant.
+		bool building;
+		// Build error of a failed variant, whose program and kernel are NULL.
+		cl_int error;
+	};
+
+	cl_int build(const oclSpecialization& spec, Variant* variant);
+
+	cl_context m_context;
+	cl_device_id m_device;
+	std::string m_kernelName;
+	std::vector<std::string> m_parameterNames;
+	std::string m_baseOptions;
+	oclVariantMode m_mode;
+	std::string m_source;
+	bool m_sourceLoaded;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_built;
+	std::map<std::string, Variant> m_variants;
+};
+
+#endif
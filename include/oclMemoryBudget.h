@@ -0,0 +1,111 @@
+#ifndef OCL_MEMORY_BUDGET_H
+#define OCL_MEMORY_BUDGET_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <CL/cl.h>
+
+// Share of CL_DEVICE_GLOBAL_MEM_SIZE given to a device's default budget.
+// The rest is left to the driver, images and other processes.
+#ifndef OCL_UTIL_BUDGET_PERCENT
+#define OCL_UTIL_BUDGET_PERCENT 90
+#endif
+
+// Counts live device bytes against a limit. Allocations that don't fit either
+// fail straight away (tryReserve) or wait for other threads to release memory
+// (reserve), which gives producers back-pressure instead of
+// CL_MEM_OBJECT_ALLOCATION_FAILURE at enqueue time.
+class oclMemoryBudget
+{
+public:
+	explicit oclMemoryBudget(cl_ulong limitBytes);
+
+	bool tryReserve(cl_ulong bytes);
+	// Waits up to timeoutMs (negative waits forever) until bytes fit.
+	// Fails at once for requests larger than the whole limit.
+	bool reserve(cl_ulong bytes, long timeoutMs = -1);
+	void release(cl_ulong bytes);
+
+	// Lowering the limit below liveBytes() only blocks new reservations.
+	void setLimit(cl_ulong limitBytes);
+
+	cl_ulong limit() const;
+	cl_ulong liveBytes() const;
+	cl_ulong peakBytes() const;
+	cl_ulong available() const;
+	// Reservations refused or timed out.
+	cl_ulong failures() const;
+
+private:
+	oclMemoryBudget(const oclMemoryBudget&);
+	oclMemoryBudget& operator=(const oclMemoryBudget&);
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_released;
+	cl_ulong m_limit;
+	cl_ulong m_live;
+	cl_ulong m_peak;
+	cl_ulong m_failures;
+};
+
+// Process wide budget of device, created on first use with
+// OCL_UTIL_BUDGET_PERCENT of its global memory. Returns NULL for invalid devices.
+oclMemoryBudget* oclGetMemoryBudget(cl_device_id device);
+
+// clCreateBuffer charged to device's budget. Waits up to timeoutMs for the
+// budget (0 fails immediately) and reports CL_MEM_OBJECT_ALLOCATION_FAILURE
+// when it doesn't fit, or CL_INVALID_BUFFER_SIZE above CL_DEVICE_MAX_MEM_ALLOC_SIZE.
+cl_mem oclCreateBudgetedBuffer(cl_context context, cl_device_id device, cl_mem_flags flags, size_t size,
+	void* hostPtr = NULL, cl_int* error = NULL, long timeoutMs = 0);
+// Releases the buffer and returns its bytes to the budget.
+void oclReleaseBudgetedBuffer(cl_mem buffer);
+
+// One piece of an oclChunkedBuffer, or the part of it covered by an access.
+struct oclChunk
+{
+	cl_mem buffer;
+	cl_uint index;
+	// Logical offset of this piece within the whole buffer.
+	size_t offset;
+	// Offset of this piece within buffer.
+	size_t bufferOffset;
+	size_t size;
+};
+
+// Logical buffer that may exceed CL_DEVICE_MAX_MEM_ALLOC_SIZE, stored as
+// several cl_mem of at most chunkSize bytes. chunkSize is a multiple of the
+// element size, so no element straddles two chunks.
+struct oclChunkedBuffer
+{
+	std::vector<cl_mem> chunks;
+	size_t size;
+	size_t chunkSize;
+
+	oclChunkedBuffer() : size(0), chunkSize(0) {}
+	cl_uint chunkCount() const { return (cl_uint)chunks.size(); }
+	bool isSplit() const { return chunks.size() > 1; }
+};
+
+// Reserves the whole size from device's budget and creates the chunks.
+// maxChunkSize 0 uses CL_DEVICE_MAX_MEM_ALLOC_SIZE.
+bool oclCreateChunkedBuffer(cl_context context, cl_device_id device, cl_mem_flags flags, size_t size,
+	oclChunkedBuffer* buffer, size_t elementSize = 1, size_t maxChunkSize = 0, long timeoutMs = 0);
+void oclReleaseChunkedBuffer(oclChunkedBuffer* buffer);
+
+// Returns CL_SUCCESS to continue. Declared with int since cl_int's alignment
+// attribute is dropped in template arguments.
+typedef std::function<int(const oclChunk&)> oclChunkFunction;
+
+// Calls function for every chunk overlapping [offset, offset + size), clipped
+// to that range, in order. Stops at and returns the first error.
+cl_int oclForEachChunk(const oclChunkedBuffer& buffer, size_t offset, size_t size,
+	const oclChunkFunction& function);
+
+cl_int oclWriteChunkedBuffer(cl_command_queue queue, const oclChunkedBuffer& buffer, size_t offset, size_t size,
+	const void* data, cl_bool blocking);
+cl_int oclReadChunkedBuffer(cl_command_queue queue, const oclChunkedBuffer& buffer, size_t offset, size_t size,
+	void* data, cl_bool blocking);
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef OCL_PIPELINE_H
+#define OCL_PIPELINE_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <CL/cl.h>
+#include <oclContext.h>
+#include <oclHandles.h>
+
+// One in-flight item of an oclPipeline.
+struct oclPipelineSlot
+{
+	cl_uint index;
+	// Sequence number of the item occupying the slot.
+	unsigned long long item;
+	// Device buffers of this slot.
+	cl_mem input;
+	cl_mem output;
+	// Pinned staging: fill hostInput before submit, read hostOutput in the consumer.
+	void* hostInput;
+	const void* hostOutput;
+	size_t inputBytes;
+	size_t outputBytes;
+};
+
+// Sets a stage's kernel arguments for slot; runs on the submitting thread just
+// before the kernel is enqueued. Per-slot intermediate buffers can be indexed
+// by slot.index. Returns CL_SUCCESS or an error code.
+typedef std::function<int(cl_kernel, const oclPipelineSlot&)> oclPipelineArgs;
+// Receives finished items in submission order on the consumer thread.
+// Exceptions it throws are passed on by oclPipeline::finish().
+typedef std::function<void(const oclPipelineSlot&)> oclPipelineConsumer;
+
+struct oclPipelineOptions
+{
+	// Items in flight: 2 for double, 3 for triple buffering.
+	cl_uint slots;
+	size_t maxInputBytes;
+	size_t maxOutputBytes;
+
+	oclPipelineOptions() : slots(3), maxInputBytes(0), maxOutputBytes(0) {}
+};
+
+// upload -> kernel chain -> download -> host consumer, with every stage on
+// its own in-order queue and consecutive items overlapping: while item n
+// runs its kernels, item n + 1 uploads and item n - 1 downloads. Stages of
+// one item are chained with events. The consumer runs on its own thread; a
+// slot is reused only after the consumer returned, so a slow consumer makes
+// acquire() block instead of letting work pile up.
+class oclPipeline
+{
+public:
+	oclPipeline();
+	~oclPipeline();
+
+	bool create(const oclContext& context, cl_uint deviceIndex, const oclPipelineOptions& options);
+	bool create(cl_context context, cl_device_id device, const oclPipelineOptions& options);
+	// Drains every submitted item, then releases queues, buffers and the consumer
+	// thread. Errors not yet collected by finish() are dropped.
+	void destroy();
+
+	// Kernel stages run in the order they are added, before the first item.
+	// globalWorkSize and localWorkSize (may be NULL) are copied.
+	bool addKernelStage(cl_kernel kernel, cl_uint workDim, const size_t* globalWorkSize,
+		const size_t* localWorkSize, const oclPipelineArgs& setArgs);
+	void setConsumer(const oclPipelineConsumer& consumer);
+
+	// Waits for a free slot (back-pressure) and returns it for filling.
+	oclPipelineSlot* acquire();
+	// Uploads inputBytes of slot->hostInput and enqueues the stages.
+	// outputBytes 0 downloads the whole output buffer.
+	cl_int submit(oclPipelineSlot* slot, size_t inputBytes, size_t outputBytes = 0);
+
+	// Waits until every submitted item has been consumed. Returns the first error,
+	// reporting failures of the consumer thread here on the calling thread, and
+	// rethrows the first exception the consumer threw.
+	cl_int finish();
+
+	cl_uint slotCount() const { return (cl_uint)m_slots.size(); }
+	unsigned long long submitted() const { return m_submitted; }
+
+private:
+	oclPipeline(const oclPipeline&);
+	oclPipeline& operator=(const oclPipeline&);
+
+	struct Stage
+	{
+		cl_kernel kernel;
+		ocl::Queue queue;
+		cl_uint workDim;
+		size_t globalWorkSize[3];
+		size_t localWorkSize[3];
+		bool hasLocalWorkSize;
+		oclPipelineArgs setArgs;
+	};
+
+	struct Slot
+	{
+		Slot() : public_(), busy(false) {}
+
+		oclPipelineSlot public_;
+		ocl::Buffer pinnedInput;
+		ocl::Buffer pinnedOutput;
+		ocl::Event downloaded;
+		bool busy;
+	};
+
+	void consumerLoop();
+	void fail(cl_int error);
+	// Waits until the consumer thread has nothing left to do.
+	void drainLocked(std::unique_lock<std::mutex>& lock);
+
+	ocl::Context m_context;
+	cl_device_id m_device;
+	ocl::Queue m_uploadQueue;
+	ocl::Queue m_downloadQueue;
+	std::vector<Stage> m_stages;
+	std::vector<Slot> m_slots;
+	oclPipelineConsumer m_consumer;
+	unsigned long long m_submitted;
+
+	std::mutex m_mutex;
+	std::condition_variable m_slotFree;
+	std::condition_variable m_work;
+	// Submitted slots in order, waiting for the consumer.
+	std::deque<Slot*> m_inFlight;
+	std::thread m_consumerThread;
+	bool m_stopping;
+	cl_int m_error;
+	// Raised on the consumer thread, reported by finish().
+	cl_int m_waitError;
+	std::exception_ptr m_exception;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef OCL_PROGRAM_CACHE_H
+#define OCL_PROGRAM_CACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <CL/cl.h>
+
+// Directory used by oclGetDefaultProgramCache, defaults to ".oclcache".
+#define OCL_UTIL_CACHE_DIR_ENV "OCL_UTIL_CACHE_DIR"
+#define OCL_UTIL_CACHE_DEFAULT_MAX_BYTES (256ULL * 1024 * 1024)
+
+struct oclProgramCacheStats
+{
+	cl_ulong hits;
+	cl_ulong misses;
+	cl_ulong stores;
+	cl_ulong evictions;
+	// Cached binaries the runtime rejected; these fall back to a source build.
+	cl_ulong loadFailures;
+};
+
+// On-disk cache of built program binaries. Entries are keyed on a hash of the
+// source, build options, device name, driver version and platform, written
+// atomically and evicted least recently used first once maxBytes is exceeded.
+class oclProgramCache
+{
+public:
+	oclProgramCache(const char* directory, cl_ulong maxBytes = OCL_UTIL_CACHE_DEFAULT_MAX_BYTES);
+
+	// Returns a program built for device, from a cached binary when possible.
+	// On a build failure the program is still returned with *error set so
+	// that oclPrintBuildLog can be used; the caller releases it.
+	cl_program build(cl_context context, cl_device_id device, const char* source, size_t length,
+		const char* options, cl_int* error);
+
+	oclProgramCacheStats stats() const;
+	// Removes every cached binary from the directory.
+	void clear();
+
+	const std::string& directory() const { return m_directory; }
+	cl_ulong maxBytes() const { return m_maxBytes; }
+
+private:
+	std::string entryKey(cl_device_id device, const char* source, size_t length, const char* options, cl_ulong* hash) const;
+	cl_program loadBinary(cl_context context, cl_device_id device, const std::string& path,
+		const std::string& key, const char* options);
+	void storeBinary(cl_program program, cl_device_id device, const std::string& path, const std::string& key);
+	void evict();
+
+	std::string m_directory;
+	cl_ulong m_maxBytes;
+	std::mutex m_evictMutex;
+
+	std::atomic<unsigned long long> m_hits;
+	std::atomic<unsigned long long> m_misses;
+	std::atomic<unsigned long long> m_stores;
+	std::atomic<unsigned long long> m_evictions;
+	std::atomic<unsigned long long> m_loadFailures;
+};
+
+// Process-wide cache in $OCL_UTIL_CACHE_DIR (or ".oclcache").
+oclProgramCache* oclGetDefaultProgramCache();
+
+// Builds through the default cache.
+cl_program oclBuildProgramCached(cl_context context, cl_device_id device, const char* source, size_t length,
+	const char* options, cl_int* error);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef OCL_REGISTRY_H
+#define OCL_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <CL/cl.h>
+#include <oclDeviceInfo.h>
+
+struct oclPlatformEntry
+{
+	cl_platform_id platform;
+	std::string profile;
+	std::string version;
+	std::string name;
+	std::string vendor;
+	std::string extensions;
+	// Every device of the platform in clGetDeviceIDs order, with its snapshot.
+	std::vector<cl_device_id> devices;
+	std::vector<const oclDeviceInfo*> deviceInfo;
+};
+
+// Platforms and devices of the process, enumerated once and never modified.
+struct oclRegistry
+{
+	// Result of clGetPlatformIDs; platforms is empty on failure.
+	cl_int error;
+	std::vector<oclPlatformEntry> platforms;
+
+	const oclPlatformEntry* findPlatform(cl_platform_id platform) const;
+	// Devices of platform whose type matches deviceType, in enumeration order.
+	std::vector<cl_device_id> devices(cl_platform_id platform, cl_device_type deviceType) const;
+};
+
+// Enumerates on first use, probing all platforms concurrently. Thread safe;
+// calls after the first are a single atomic load.
+const oclRegistry* oclGetRegistry();
+
+#endif
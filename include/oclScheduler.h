@@ -0,0 +1,91 @@
+#ifndef OCL_SCHEDULER_H
+#define OCL_SCHEDULER_H
+
+#include <mutex>
+#include <vector>
+#include <CL/cl.h>
+#include <oclContext.h>
+#include <oclHandles.h>
+
+struct oclSchedulerStats
+{
+	// Per device of the context, in context order.
+	std::vector<unsigned long long> dispatched;
+	std::vector<double> weights;
+};
+
+// Dispatches independent kernel launches across every device of an oclContext.
+// Each launch goes to the queue whose outstanding work, divided by the
+// device's throughput, is lowest once the new launch is added, so a box
+// with an iGPU, a dGPU and a CPU keeps all three busy in proportion to their
+// speed. Outstanding work is tracked per queue from the events of launches
+// still queued or running.
+// Kernels must be built for all devices of the context. Setting arguments and
+// enqueueing from several threads needs one cl_kernel per thread.
+class oclScheduler
+{
+public:
+	oclScheduler();
+	~oclScheduler();
+
+	// Uses context's queues. Weights come from oclGetDeviceThroughput, measured
+	// with a short benchmark kernel (once per device) when measureThroughput is
+	// set, estimated otherwise.
+	// context must outlive the scheduler.
+	bool create(const oclContext& context, bool measureThroughput = true);
+	// Waits for outstanding work.
+	void destroy();
+
+	// Relative speed of deviceIndex; larger receives more work.
+	void setWeight(cl_uint deviceIndex, double weight);
+
+	// Index of the device that would finish cost units of extra work first.
+	cl_uint pick(double cost = 1.0);
+
+	// Enqueues kernel on the picked queue. cost 0 uses the product of
+	// globalWorkSize. waitList may hold events from any queue of the context.
+	cl_int enqueueKernel(cl_kernel kernel, cl_uint workDim, const size_t* globalWorkSize,
+		const size_t* localWorkSize, cl_uint waitCount = 0, const cl_event* waitList = NULL,
+		cl_event* event = NULL, double cost = 0.0, cl_uint* deviceIndex = NULL);
+
+	// Records work enqueued by the caller on queue(deviceIndex), e.g. after pick().
+	// event is retained until it completes.
+	void track(cl_uint deviceIndex, cl_event event, double cost);
+
+	cl_command_queue queue(cl_uint deviceIndex) const { return m_queues[deviceIndex].queue; }
+	cl_uint deviceCount() const { return (cl_uint)m_queues.size(); }
+	// Cost of launches not yet complete on deviceIndex.
+	double outstanding(cl_uint deviceIndex);
+
+	cl_int flush();
+	cl_int finish();
+	oclSchedulerStats stats() const;
+
+private:
+	oclScheduler(const oclScheduler&);
+	oclScheduler& operator=(const oclScheduler&);
+
+	struct Pending
+	{
+		ocl::Event event;
+		double cost;
+	};
+	struct DeviceQueue
+	{
+		cl_device_id device;
+		ocl::Queue queue;
+		double weight;
+		double outstanding;
+		cl_ulong dispatched;
+		std::vector<Pending> pending;
+	};
+
+	// Drops completed launches from the outstanding work of every queue.
+	void pollLocked();
+	cl_uint pickLocked(double cost);
+
+	mutable std::mutex m_mutex;
+	std::vector<DeviceQueue> m_queues;
+};
+
+#endif
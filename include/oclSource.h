@@ -0,0 +1,33 @@
+#ifndef OCL_SOURCE_H
+#define OCL_SOURCE_H
+
+#include <memory>
+#include <vector>
+#include <CL/cl.h>
+
+// Read-only, memory mapped view of a kernel source file. The data is not
+// NUL terminated; pass length along to clCreateProgramWithSource. The
+// mapping stays valid for as long as any view of it is alive.
+struct oclSourceView
+{
+	const char* data;
+	size_t length;
+	std::shared_ptr<const void> owner;
+
+	oclSourceView() : data(NULL), length(0) {}
+};
+
+// Maps filename, reusing the cached mapping if the file's size and
+// modification time are unchanged since it was last loaded.
+bool oclMapProgramSource(const char* filename, oclSourceView* view);
+
+// Maps several files in one call. views receives one entry per file.
+bool oclMapProgramSources(const char* const* filenames, cl_uint count, std::vector<oclSourceView>* views);
+
+// Creates a program from the concatenation of several source files without copying them.
+cl_program oclCreateProgramFromFiles(cl_context context, const char* const* filenames, cl_uint count, cl_int* error);
+
+// Drops cached mappings. Views still held by callers stay valid.
+void oclClearSourceCache();
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef OCL_SOURCE_BUNDLE_H
+#define OCL_SOURCE_BUNDLE_H
+
+#include <string>
+#include <vector>
+#include <CL/cl.h>
+
+struct oclSourceDependency
+{
+	std::string path;
+	cl_ulong contentHash;
+	cl_ulong size;
+	cl_ulong mtime;
+	// Indices into oclSourceBundle::dependencies of the files this one includes.
+	std::vector<size_t> includes;
+};
+
+// A kernel source with its #include directives expanded on the host.
+struct oclSourceBundle
+{
+	// Single translation unit, with #line directives pointing back at the original files.
+	std::string source;
+	// Every file that went into source, root file first.
+	std::vector<oclSourceDependency> dependencies;
+	// Combined hash of the dependency contents.
+	cl_ulong hash;
+
+	oclSourceBundle() : hash(0) {}
+};
+
+// Expands #include "..." (relative to the including file, then includePaths)
+// and #include <...> (includePaths only) starting at filename. Files containing
+// #pragma once are expanded once. Unresolved includes are left for the compiler.
+bool oclBundleProgramSource(const char* filename, const std::vector<std::string>& includePaths, oclSourceBundle* bundle);
+
+// True if any dependency's content differs from when the bundle was made.
+// Files whose size and modification time are unchanged are not rehashed;
+// files touched without a content change get their recorded stat updated.
+bool oclSourceBundleIsStale(oclSourceBundle* bundle);
+
+// Re-bundles only if the bundle is empty or stale. Returns false on error.
+bool oclRefreshSourceBundle(const char* filename, const std::vector<std::string>& includePaths, oclSourceBundle* bundle);
+
+// Builds the bundled source through the program binary cache, so an unchanged
+// dependency set reuses the cached binary.
+cl_program oclBuildBundledProgram(cl_context context, cl_device_id device, const oclSourceBundle& bundle,
+	const char* options, cl_int* error);
+
+#endif
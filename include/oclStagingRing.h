@@ -0,0 +1,61 @@
+#ifndef OCL_STAGING_RING_H
+#define OCL_STAGING_RING_H
+
+#include <vector>
+#include <CL/cl.h>
+
+// Ring of pinned (CL_MEM_ALLOC_HOST_PTR) staging buffers that stay mapped for
+// the lifetime of the ring. Uploads are copied into a slot and sent to the
+// destination with a non-blocking clEnqueueWriteBuffer from the pinned
+// pointer, which lets the driver DMA directly instead of copying pageable
+// memory first. A slot is reused once its write event has completed.
+// Not thread safe; use one ring per producer thread.
+class oclStagingRing
+{
+public:
+	oclStagingRing();
+	~oclStagingRing();
+
+	bool create(cl_context context, cl_command_queue queue, size_t slotSize, cl_uint slotCount = 3);
+	// Waits for outstanding uploads, then unmaps and releases the slots.
+	void destroy();
+
+	// Copies src through the ring into dst at dstOffset, splitting it across
+	// slots as needed. src may be reused as soon as this returns. event receives
+	// the event of the last write (the caller releases it).
+	cl_int upload(cl_mem dst, size_t dstOffset, const void* src, size_t size, cl_event* event = NULL);
+
+	// Copy free variant: fill the returned slot (at most slotSize() bytes) in
+	// place, then commit it. Only one slot can be acquired at a time.
+	void* acquire();
+	cl_int commit(cl_mem dst, size_t dstOffset, size_t size, cl_event* event = NULL);
+
+	cl_int flush();
+	// Waits for every in-flight slot.
+	cl_int finish();
+
+	size_t slotSize() const { return m_slotSize; }
+	cl_uint slotCount() const { return (cl_uint)m_slots.size(); }
+
+private:
+	oclStagingRing(const oclStagingRing&);
+	oclStagingRing& operator=(const oclStagingRing&);
+
+	struct Slot
+	{
+		cl_mem buffer;
+		void* host;
+		cl_event inFlight;
+	};
+
+	// Waits for the next slot to drain and returns it.
+	Slot* nextSlot();
+
+	cl_command_queue m_queue;
+	size_t m_slotSize;
+	std::vector<Slot> m_slots;
+	size_t m_next;
+	Slot* m_acquired;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef OCL_STREAM_H
+#define OCL_STREAM_H
+
+#include <stdio.h>
+#include <functional>
+#include <vector>
+#include <CL/cl.h>
+#include <oclContext.h>
+#include <oclHandles.h>
+
+// Kernel argument index meaning "don't pass this value".
+#define OCL_UTIL_STREAM_NO_ARG ((cl_uint)-1)
+
+// Fill dst with count elements starting at element first. Chunks are requested in order.
+// first is unsigned long long rather than cl_ulong, whose alignment attribute
+// is dropped in template arguments.
+typedef std::function<bool(void* dst, unsigned long long first, size_t count)> oclStreamReader;
+// Consume count result elements starting at element first. Chunks arrive in order.
+typedef std::function<bool(const void* src, unsigned long long first, size_t count)> oclStreamWriter;
+
+struct oclStreamOptions
+{
+	size_t inputElementSize;
+	// 0 runs the kernel in place and downloads the input buffer.
+	size_t outputElementSize;
+	// Elements per chunk, 0 picks about 32 MByte of input that fits the device budget.
+	size_t chunkElements;
+	// Chunks in flight, 2 (double) or 3 (triple buffering).
+	cl_uint depth;
+	// 0 lets the driver choose; otherwise the global size is rounded up to it.
+	size_t localSize;
+
+	// Kernel argument layout: __global input, __global output, uint count,
+	// ulong first element. OCL_UTIL_STREAM_NO_ARG skips an argument.
+	cl_uint inputArg;
+	cl_uint outputArg;
+	cl_uint countArg;
+	cl_uint firstArg;
+
+	oclStreamOptions()
+		: inputElementSize(sizeof(cl_float))
+		, outputElementSize(sizeof(cl_float))
+		, chunkElements(0)
+		, depth(3)
+		, localSize(0)
+		, inputArg(0)
+		, outputArg(1)
+		, countArg(2)
+		, firstArg(OCL_UTIL_STREAM_NO_ARG)
+	{}
+};
+
+struct oclStreamStats
+{
+	cl_ulong chunks;
+	cl_ulong bytesUploaded;
+	cl_ulong bytesDownloaded;
+	double seconds;
+};
+
+// Runs a kernel over a dataset larger than device memory. The data is split
+// into chunks, and chunk n + 1 uploads while chunk n computes and chunk n - 1
+// downloads, each on its own queue and chained with events. Every slot has
+// device buffers plus pinned host staging, so the reader and writer work on
+// DMA capable memory and overlap the device.
+class oclStreamExecutor
+{
+public:
+	oclStreamExecutor();
+	~oclStreamExecutor();
+
+	// Device buffers are charged to device's oclMemoryBudget.
+	bool create(cl_context context, cl_device_id device, const oclStreamOptions& options = oclStreamOptions());
+	// Uses context.devices[deviceIndex]; the stream keeps its own queues.
+	bool create(const oclContext& context, cl_uint deviceIndex, const oclStreamOptions& options = oclStreamOptions());
+	void destroy();
+
+	// Streams totalElements through kernel. The kernel must ignore work items
+	// at or past the count argument, since the global size is rounded up.
+	// writer may be empty for kernels that produce no per-element output.
+	cl_int run(cl_kernel kernel, cl_ulong totalElements, const oclStreamReader& reader,
+		const oclStreamWriter& writer = oclStreamWriter());
+
+	size_t chunkElements() const { return m_options.chunkElements; }
+	const oclStreamStats& stats() const { return m_stats; }
+
+private:
+	oclStreamExecutor(const oclStreamExecutor&);
+	oclStreamExecutor& operator=(const oclStreamExecutor&);
+
+	struct Slot
+	{
+		// Budgeted, released with oclReleaseBudgetedBuffer.
+		cl_mem input;
+		cl_mem output;
+		ocl::Buffer pinnedInput;
+		ocl::Buffer pinnedOutput;
+		void* hostInput;
+		void* hostOutput;
+		ocl::Event downloaded;
+		cl_ulong first;
+		size_t count;
+	};
+
+	bool createSlot(Slot* slot);
+	cl_int enqueueChunk(Slot* slot, cl_kernel kernel, bool download);
+	// Waits for the slot's chunk and hands it to writer.
+	cl_int retireSlot(Slot* slot, const oclStreamWriter& writer);
+	size_t outputElementSize() const;
+
+	ocl::Context m_context;
+	cl_device_id m_device;
+	ocl::Queue m_uploadQueue;
+	ocl::Queue m_computeQueue;
+	ocl::Queue m_downloadQueue;
+	oclStreamOptions m_options;
+	std::vector<Slot> m_slots;
+	oclStreamStats m_stats;
+};
+
+// Readers and writers over a host array or a file. The file versions use the
+// current position and read or write sequentially.
+oclStreamReader oclStreamFromArray(const void* data, size_t elementSize);
+oclStreamReader oclStreamFromFile(FILE* file, size_t elementSize);
+oclStreamWriter oclStreamToArray(void* data, size_t elementSize);
+oclStreamWriter oclStreamToFile(FILE* file, size_t elementSize);
+
+#endif
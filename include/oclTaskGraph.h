@@ -0,0 +1,111 @@
+#ifndef OCL_TASK_GRAPH_H
+#define OCL_TASK_GRAPH_H
+
+#include <functional>
+#include <vector>
+#include <CL/cl.h>
+#include <oclHandles.h>
+
+// Sets the arguments of a kernel node right before it is enqueued, so several
+// nodes can share one cl_kernel. Returns CL_SUCCESS or an error code.
+typedef std::function<int(cl_kernel)> oclTaskArgs;
+
+// Kernels, transfers and host callbacks connected by explicit dependencies.
+// execute() walks the graph in dependency order and turns every edge into an
+// event wait list instead of a clFinish. On devices reporting
+// CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE everything goes to one out-of-order
+// queue; otherwise independent branches are spread over several in-order
+// queues, with chains kept on the queue of their predecessor.
+// Host callbacks run on the calling thread once their dependencies completed;
+// nodes that don't depend on them are submitted first.
+class oclTaskGraph
+{
+public:
+	typedef size_t Node;
+	typedef std::vector<Node> Nodes;
+
+	oclTaskGraph();
+	~oclTaskGraph();
+
+	// inOrderQueues is only used when the device can't execute out of order.
+	bool create(cl_context context, cl_device_id device, cl_uint inOrderQueues = 3);
+	void destroy();
+
+	Node addKernel(cl_kernel kernel, cl_uint workDim, const size_t* globalWorkSize,
+		const size_t* localWorkSize = NULL, const Nodes& dependencies = Nodes());
+	// data must stay valid until the graph has finished executing.
+	Node addWrite(cl_mem buffer, size_t offset, size_t size, const void* data, const Nodes& dependencies = Nodes());
+	Node addRead(cl_mem buffer, size_t offset, size_t size, void* data, const Nodes& dependencies = Nodes());
+	Node addCopy(cl_mem source, size_t sourceOffset, cl_mem destination, size_t destinationOffset, size_t size,
+		const Nodes& dependencies = Nodes());
+	Node addHost(const std::function<void()>& function, const Nodes& dependencies = Nodes());
+
+	void addDependency(Node node, Node dependsOn);
+	void setKernelArgs(Node node, const oclTaskArgs& setArgs);
+	// Removes every node; queues are kept.
+	void clear();
+
+	// Submits the whole graph. Without wait, call finish() before touching
+	// read destinations or executing again.
+	cl_int execute(bool wait = true);
+	cl_int finish();
+
+	size_t nodeCount() const { return m_nodes.size(); }
+	bool outOfOrder() const { return m_outOfOrder; }
+	cl_uint queueCount() const { return (cl_uint)m_queues.size(); }
+
+private:
+	oclTaskGraph(const oclTaskGraph&);
+	oclTaskGraph& operator=(const oclTaskGraph&);
+
+	enum NodeType
+	{
+		NodeKernel,
+		NodeWrite,
+		NodeRead,
+		NodeCopy,
+		NodeHost
+	};
+
+	struct Task
+	{
+		NodeType type;
+		Nodes dependencies;
+
+		cl_kernel kernel;
+		cl_uint workDim;
+		size_t globalWorkSize[3];
+		size_t localWorkSize[3];
+		bool hasLocalWorkSize;
+		oclTaskArgs setArgs;
+
+		cl_mem buffer;
+		cl_mem destination;
+		size_t offset;
+		size_t destinationOffset;
+		size_t size;
+		const void* source;
+		void* target;
+
+		std::function<void()> host;
+
+		// Filled during execute.
+		ocl::Event event;
+		size_t queue;
+	};
+
+	Node add(Task task, const Nodes& dependencies);
+	// Topological order, device work before host callbacks where possible.
+	bool schedule(std::vector<Node>* order) const;
+	size_t chooseQueue(const Task& task, const std::vector<Node>& queueTails, const std::vector<size_t>& lastUse) const;
+	cl_int submit(Task* task);
+	void releaseEvents();
+
+	ocl::Context m_context;
+	cl_device_id m_device;
+	std::vector<ocl::Queue> m_queues;
+	bool m_outOfOrder;
+	std::vector<Task> m_nodes;
+};
+
+#endif
@@ -1,6 +1,18 @@
 #ifndef OCL_UTIL_H
 #define OCL_UTIL_H
 
+#include <stdexcept>
+#include <CL/cl.h>
+
+// Compile-time ceiling for oclHandleErrorMessage output:
+// 0 silent, 1 print failures, 2 also print every successful action.
+#ifndef OCL_UTIL_VERBOSITY
+#define OCL_UTIL_VERBOSITY 1
+#endif
+
+// Number of failures remembered per thread.
+#define OCL_UTIL_ERROR_RING_SIZE 32
+
 char *oclLoadProgramContents(const char *filename, int *length);
 
 #ifdef OCL_UTIL_GL_SHARING_ENABLE
@@ -13,7 +25,61 @@ bool oclGetSomeGPUDevice(cl_device_id* deviceId , cl_platform_id platformId);
 bool oclCreateSomeContext(cl_context* context , cl_device_id deviceId,cl_platform_id platformId);
 
 const char* oclErrorString(cl_int error);
-bool oclHandleErrorMessage(const char* action, cl_int error);
+
+struct oclErrorRecord
+{
+	// Truncated copy of the action passed to oclHandleErrorMessage.
+	char action[64];
+	cl_int code;
+	// oclErrorString(code)
+	const char* message;
+	// Nanoseconds since the epoch.
+	cl_ulong timestamp;
+};
+
+class oclException : public std::runtime_error
+{
+public:
+	oclException(const char* action, cl_int error);
+	cl_int error() const { return m_error; }
+
+private:
+	cl_int m_error;
+};
+
+// Slow path of oclHandleErrorMessage: records the failure in the calling thread's
+// error ring, prints it if the verbosity allows and throws if exceptions are enabled.
+bool oclReportError(const char* action, cl_int error);
+void oclReportSuccess(const char* action);
+
+// Returns true on CL_SUCCESS. Success does no I/O unless OCL_UTIL_VERBOSITY >= 2.
+inline bool oclHandleErrorMessage(const char* action, cl_int error)
+{
+	if(error == CL_SUCCESS)
+	{
+#if OCL_UTIL_VERBOSITY >= 2
+		oclReportSuccess(action);
+#endif
+		return true;
+	}
+	return oclReportError(action, error);
+}
+
+// Runtime verbosity, clamped to OCL_UTIL_VERBOSITY.
+void oclSetVerbosity(int level);
+int oclGetVerbosity();
+
+// When enabled, failures reported through oclHandleErrorMessage throw oclException.
+// Helpers do not unwind partially created objects, so treat a throw as fatal for
+// the objects involved. Defaults to on when OCL_UTIL_THROW_ON_ERROR is defined.
+void oclSetThrowOnError(bool enable);
+
+// Copies up to maxRecords of the calling thread's failures, newest first.
+size_t oclGetErrorRecords(oclErrorRecord* records, size_t maxRecords);
+bool oclGetLastError(oclErrorRecord* record);
+// Total failures recorded on the calling thread, including ones that left the ring.
+cl_ulong oclGetErrorCount();
+void oclClearErrors();
 
 void oclPrintPlatformInfo(cl_platform_id id);
 void oclPrintDeviceInfo(cl_device_id device);
@@ -0,0 +1,219 @@
+#ifndef OCL_VECTOR_H
+#define OCL_VECTOR_H
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <CL/cl.h>
+#include <oclHandles.h>
+
+enum oclVectorAccess
+{
+	oclVectorRead,
+	oclVectorWrite,
+	oclVectorReadWrite
+};
+
+// Sorted, disjoint list of [begin, end) byte ranges. Once more than maxRanges
+// are tracked, neighbours are merged across their smallest gaps.
+class oclRangeSet
+{
+public:
+	typedef std::pair<size_t, size_t> Range;
+
+	explicit oclRangeSet(size_t maxRanges = 16) : m_maxRanges(maxRanges) {}
+
+	// Gaps that intersect exclude are never merged over, so the set may then
+	// hold more than maxRanges ranges.
+	void add(size_t begin, size_t end, const oclRangeSet* exclude = NULL);
+	void remove(size_t begin, size_t end);
+	// Drops everything at or past end.
+	void clip(size_t end) { remove(end, (size_t)-1); }
+	void clear() { m_ranges.clear(); }
+
+	bool empty() const { return m_ranges.empty(); }
+	bool intersects(size_t begin, size_t end) const;
+	const std::vector<Range>& ranges() const { return m_ranges; }
+
+private:
+	void collapse(const oclRangeSet* exclude);
+
+	std::vector<Range> m_ranges;
+	size_t m_maxRanges;
+};
+
+// Untyped storage behind oclVector<T>; all sizes and offsets are in bytes.
+// Keeps a host copy and a device buffer and remembers which side holds the
+// newer data for each range, so transfers only happen for ranges that changed
+// and only when the other side asks for them.
+// Uploads are non-blocking and rely on queue being in-order.
+class oclVectorStorage
+{
+public:
+	oclVectorStorage();
+	~oclVectorStorage();
+
+	bool create(cl_context context, cl_command_queue queue, cl_mem_flags flags = CL_MEM_READ_WRITE);
+	// Waits for pending uploads and frees both copies.
+	void destroy();
+
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_hostCapacity; }
+
+	// Grows both copies to at least bytes without touching size().
+	// The device buffer is resized with a device side copy, never through the host.
+	cl_int reserve(size_t bytes);
+	// Newly exposed bytes are filled from fill (fillSize bytes repeated) and
+	// marked host dirty. Shrinking keeps the capacity.
+	cl_int resize(size_t bytes, const void* fill, size_t fillSize);
+
+	// Host access to [offset, offset + bytes). Device dirty parts of the range
+	// are downloaded first unless access is oclVectorWrite; write access marks
+	// the range host dirty.
+	void* host(size_t offset, size_t bytes, oclVectorAccess access, cl_int* error = NULL);
+
+	// Uploads host dirty ranges (skipped for oclVectorWrite, which discards them)
+	// and, for write access, marks the whole buffer device dirty.
+	cl_mem device(oclVectorAccess access, cl_int* error = NULL);
+	// Narrows what a kernel wrote: only [offset, offset + bytes) is marked device dirty.
+	cl_mem device(size_t offset, size_t bytes, cl_int* error = NULL);
+
+	// Brings the host copy fully up to date.
+	cl_int syncHost();
+	// Uploads every host dirty range and waits for the writes.
+	cl_int syncDevice();
+
+	cl_ulong bytesUploaded() const { return m_bytesUploaded; }
+	cl_ulong bytesDownloaded() const { return m_bytesDownloaded; }
+	cl_command_queue queue() const { return m_queue; }
+
+private:
+	oclVectorStorage(const oclVectorStorage&);
+	oclVectorStorage& operator=(const oclVectorStorage&);
+
+	cl_int reserveDevice(size_t bytes);
+	cl_int upload();
+	cl_int download(size_t begin, size_t end);
+	// Host memory may be read by in-flight uploads; wait before changing it.
+	void waitUploads();
+
+	ocl::Context m_context;
+	ocl::Queue m_queue;
+	cl_mem_flags m_flags;
+
+	char* m_host;
+	size_t m_hostCapacity;
+	ocl::Buffer m_buffer;
+	size_t m_deviceCapacity;
+	size_t m_size;
+
+	// Host newer than device.
+	oclRangeSet m_hostDirty;
+	// Device newer than host.
+	oclRangeSet m_deviceDirty;
+	// Owned references, kept raw so they can be passed to clWaitForEvents as is.
+	std::vector<cl_event> m_uploads;
+
+	cl_ulong m_bytesUploaded;
+	cl_ulong m_bytesDownloaded;
+};
+
+// Typed host/device array with lazy coherence. Typical use:
+//
+//   oclVector<cl_float> x;
+//   x.create(context, queue);
+//   x.resize(n);
+//   fill(x.hostWrite(), n);                          // host dirty
+//   x.setKernelArg(kernel, 0, oclVectorReadWrite);   // uploads, device dirty
+//   clEnqueueNDRangeKernel(queue, kernel, ...);
+//   const cl_float* r = x.hostRead(0, 16);           // downloads 16 elements
+//
+// T must be a plain data type matching the kernel side layout.
+template<typename T>
+class oclVector
+{
+	static_assert(std::is_pod<T>::value, "oclVector<T> requires a plain data type");
+
+public:
+	static const size_t npos = (size_t)-1;
+
+	bool create(cl_context context, cl_command_queue queue, cl_mem_flags flags = CL_MEM_READ_WRITE)
+	{
+		return m_storage.create(context, queue, flags);
+	}
+	void destroy() { m_storage.destroy(); }
+
+	size_t size() const { return m_storage.size() / sizeof(T); }
+	size_t capacity() const { return m_storage.capacity() / sizeof(T); }
+	bool empty() const { return m_storage.size() == 0; }
+
+	cl_int reserve(size_t count) { return m_storage.reserve(count * sizeof(T)); }
+	cl_int resize(size_t count, const T& value = T()) { return m_storage.resize(count * sizeof(T), &value, sizeof(T)); }
+
+	// Replaces the contents without downloading anything.
+	cl_int assign(const T* data, size_t count)
+	{
+		cl_int error = resize(count);
+		T* host = error == CL_SUCCESS && count > 0 ? hostWrite(0, count, &error) : NULL;
+		if(host != NULL)
+			std::copy(data, data + count, host);
+		return error;
+	}
+
+	// Pointers are valid until the next resize/reserve or device access.
+	const T* hostRead(size_t first = 0, size_t count = npos, cl_int* error = NULL)
+	{
+		return (const T*)host(first, count, oclVectorRead, error);
+	}
+	// Read-modify-write: downloads stale parts, then marks the range host dirty.
+	T* hostReadWrite(size_t first = 0, size_t count = npos, cl_int* error = NULL)
+	{
+		return (T*)host(first, count, oclVectorReadWrite, error);
+	}
+	// Overwrite: marks the range host dirty and discards device changes to it.
+	T* hostWrite(size_t first = 0, size_t count = npos, cl_int* error = NULL)
+	{
+		return (T*)host(first, count, oclVectorWrite, error);
+	}
+
+	cl_mem device(oclVectorAccess access = oclVectorReadWrite, cl_int* error = NULL)
+	{
+		return m_storage.device(access, error);
+	}
+	// For kernels that write only part of the buffer.
+	cl_mem deviceWrites(size_t first, size_t count, cl_int* error = NULL)
+	{
+		return m_storage.device(first * sizeof(T), count * sizeof(T), error);
+	}
+
+	cl_int setKernelArg(cl_kernel kernel, cl_uint index, oclVectorAccess access = oclVectorReadWrite)
+	{
+		cl_int error;
+		cl_mem buffer = device(access, &error);
+		if(error != CL_SUCCESS)
+			return error;
+		return clSetKernelArg(kernel, index, sizeof(cl_mem), &buffer);
+	}
+
+	cl_int syncHost() { return m_storage.syncHost(); }
+	cl_int syncDevice() { return m_storage.syncDevice(); }
+
+	oclVectorStorage& storage() { return m_storage; }
+	const oclVectorStorage& storage() const { return m_storage; }
+
+private:
+	void* host(size_t first, size_t count, oclVectorAccess access, cl_int* error)
+	{
+		const size_t elements = size();
+		if(first > elements)
+			first = elements;
+		if(count > elements - first)
+			count = elements - first;
+		return m_storage.host(first * sizeof(T), count * sizeof(T), access, error);
+	}
+
+	oclVectorStorage m_storage;
+};
+
+#endif
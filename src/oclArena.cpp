@@ -0,0 +1,235 @@
+#include <stdio.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclArena.h>
+#include <oclHostAlloc.h>
+#include "oclCompat.h"
+
+static size_t oclAlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+cl_mem oclArenaRange::buffer() const
+{
+	return subBuffer ? subBuffer : (arena ? arena->buffer() : NULL);
+}
+
+oclDeviceArena::oclDeviceArena()
+	: m_buffer(NULL)
+	, m_flags(0)
+	, m_capacity(0)
+	, m_alignment(1)
+	, m_used(0)
+	, m_useSubBuffers(false)
+{
+}
+
+oclDeviceArena::~oclDeviceArena()
+{
+	destroy();
+}
+
+bool oclDeviceArena::create(cl_context context, cl_device_id device, size_t size, cl_mem_flags flags, bool useSubBuffers)
+{
+	destroy();
+
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	if(info == NULL)
+		return false;
+
+	if(info->maxMemAllocSize > 0 && size > info->maxMemAllocSize)
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Arena of %u MByte clamped to CL_DEVICE_MAX_MEM_ALLOC_SIZE (%u MByte)\n",
+				(unsigned int)(size >> 20), (unsigned int)(info->maxMemAllocSize >> 20));
+		size = (size_t)info->maxMemAllocSize;
+	}
+
+	// CL_DEVICE_MEM_BASE_ADDR_ALIGN is in bits. Sub-buffer origins must honour it.
+	m_alignment = info->memBaseAddrAlign / 8;
+	if(m_alignment < 16)
+		m_alignment = 16;
+
+	cl_int error;
+	m_buffer = clCreateBuffer(context, flags, size, NULL, &error);
+	if( !oclHandleErrorMessage("Creating arena buffer", error) )
+	{
+		m_buffer = NULL;
+		return false;
+	}
+
+	m_flags = flags;
+	m_capacity = size;
+	m_useSubBuffers = useSubBuffers && info->versionAtLeast(1, 1) && oclGetCreateSubBuffer() != NULL;
+	reset();
+	return true;
+}
+
+void oclDeviceArena::destroy()
+{
+	releaseSubBuffers();
+	if(m_buffer != NULL)
+		clReleaseMemObject(m_buffer);
+	m_buffer = NULL;
+	m_capacity = 0;
+	m_used = 0;
+	m_free.clear();
+}
+
+void oclDeviceArena::releaseSubBuffers()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(std::map<size_t, cl_mem>::iterator it = m_subBuffers.begin(); it != m_subBuffers.end(); ++it)
+		clReleaseMemObject(it->second);
+	m_subBuffers.clear();
+}
+
+void oclDeviceArena::reset()
+{
+	releaseSubBuffers();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_free.clear();
+	if(m_capacity > 0)
+		m_free[0] = m_capacity;
+	m_used = 0;
+}
+
+bool oclDeviceArena::allocate(size_t size, oclArenaRange* range, size_t alignment)
+{
+	if(alignment == 0)
+		alignment = m_alignment;
+	if(size == 0)
+		size = 1;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for(std::map<size_t, size_t>::iterator it = m_free.begin(); it != m_free.end(); ++it)
+	{
+		const size_t blockStart = it->first;
+		const size_t blockEnd = it->first + it->second;
+		const size_t start = oclAlignUp(blockStart, alignment);
+		size_t end = start + size;
+		if(end > blockEnd)
+			continue;
+		// Round the end up too where possible, so that the remainder stays aligned.
+		if(oclAlignUp(end, m_alignment) <= blockEnd)
+			end = oclAlignUp(end, m_alignment);
+
+		m_free.erase(it);
+		if(start > blockStart)
+			m_free[blockStart] = start - blockStart;
+		if(end < blockEnd)
+			m_free[end] = blockEnd - end;
+		m_used += end - start;
+
+		range->arena = this;
+		range->offset = start;
+		range->size = end - start;
+		range->subBuffer = NULL;
+		lock.unlock();
+
+		if(m_useSubBuffers)
+		{
+			cl_buffer_region region;
+			region.origin = range->offset;
+			region.size = range->size;
+			cl_int error;
+			range->subBuffer = oclGetCreateSubBuffer()(m_buffer, m_flags & (CL_MEM_READ_WRITE | CL_MEM_READ_ONLY | CL_MEM_WRITE_ONLY),
+				CL_BUFFER_CREATE_TYPE_REGION, &region, &error);
+			if(error != CL_SUCCESS)
+				range->subBuffer = NULL; // offsets still work without the view
+			else
+			{
+				lock.lock();
+				m_subBuffers[range->offset] = range->subBuffer;
+			}
+		}
+		return true;
+	}
+	return false;
+}
+
+void oclDeviceArena::free(oclArenaRange* range)
+{
+	if(range->arena != this)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// Only release views still owned here; reset() and destroy() already released theirs.
+	std::map<size_t, cl_mem>::iterator view = m_subBuffers.find(range->offset);
+	if( view != m_subBuffers.end() && view->second == range->subBuffer )
+	{
+		clReleaseMemObject(view->second);
+		m_subBuffers.erase(view);
+	}
+
+	size_t start = range->offset;
+	size_t size = range->size;
+	m_used -= size;
+
+	// Coalesce with the following block
+	std::map<size_t, size_t>::iterator next = m_free.lower_bound(start);
+	if( next != m_free.end() && next->first == start + size )
+	{
+		size += next->second;
+		m_free.erase(next);
+	}
+	// and with the preceding one
+	std::map<size_t, size_t>::iterator it = m_free.lower_bound(start);
+	if( it != m_free.begin() )
+	{
+		std::map<size_t, size_t>::iterator previous = it;
+		--previous;
+		if(previous->first + previous->second == start)
+		{
+			start = previous->first;
+			size += previous->second;
+			m_free.erase(previous);
+		}
+	}
+	m_free[start] = size;
+
+	*range = oclArenaRange();
+}
+
+size_t oclDeviceArena::bytesUsed() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_used;
+}
+
+cl_int oclSetArenaRangeArg(cl_kernel kernel, cl_uint index, const oclArenaRange& range, size_t elementSize)
+{
+	// The kernel indexes in elements, so the offset has to be a whole number of them.
+	if(elementSize == 0 || range.bufferOffset() % elementSize != 0 || range.bufferOffset() / elementSize > 0xFFFFFFFFu)
+		return CL_INVALID_VALUE;
+
+	cl_mem buffer = range.buffer();
+	cl_uint offset = (cl_uint)(range.bufferOffset() / elementSize);
+
+	cl_int error = clSetKernelArg(kernel, index, sizeof(cl_mem), &buffer);
+	if(error == CL_SUCCESS)
+		error = clSetKernelArg(kernel, index + 1, sizeof(cl_uint), &offset);
+	return error;
+}
+
+cl_int oclWriteArenaRange(cl_command_queue queue, const oclArenaRange& range, size_t offset, size_t size,
+	const void* data, cl_bool blocking, cl_event* event)
+{
+	if(offset + size > range.size)
+		return CL_INVALID_VALUE;
+	oclCheckHostPtr(queue, data, size, "Writing arena range");
+	return clEnqueueWriteBuffer(queue, range.buffer(), blocking, range.bufferOffset() + offset, size, data, 0, NULL, event);
+}
+
+cl_int oclReadArenaRange(cl_command_queue queue, const oclArenaRange& range, size_t offset, size_t size,
+	void* data, cl_bool blocking, cl_event* event)
+{
+	if(offset + size > range.size)
+		return CL_INVALID_VALUE;
+	oclCheckHostPtr(queue, data, size, "Reading arena range");
+	return clEnqueueReadBuffer(queue, range.buffer(), blocking, range.bufferOffset() + offset, size, data, 0, NULL, event);
+}
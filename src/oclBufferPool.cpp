@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclBufferPool.h>
+
+// Smallest size class; tiny buffers are not worth a separate class each.
+static const size_t oclPoolMinimumSize = 256;
+
+size_t oclBufferPool::sizeClass(size_t size)
+{
+	if(size <= oclPoolMinimumSize)
+		return oclPoolMinimumSize;
+
+	size_t power = oclPoolMinimumSize;
+	while(power < size && power <= ((size_t)-1) / 2)
+	{
+		const size_t threeQuarters = power + power / 2; // 1.5 * 2^k
+		if(size <= threeQuarters)
+			return threeQuarters;
+		power *= 2;
+	}
+	return power < size ? size : power;
+}
+
+// True once event has completed or failed, so commands no longer use its buffer.
+static bool oclEventDone(cl_event event)
+{
+	if(event == NULL)
+		return true;
+	cl_int status = CL_COMPLETE;
+	if( clGetEventInfo(event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL) != CL_SUCCESS )
+		return true;
+	return status <= CL_COMPLETE;
+}
+
+oclBufferPool::oclBufferPool(cl_context context, cl_ulong highWaterBytes)
+	: m_context(context)
+	, m_highWaterBytes(highWaterBytes)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	clRetainContext(m_context);
+}
+
+oclBufferPool::~oclBufferPool()
+{
+	trim(0);
+	clReleaseContext(m_context);
+}
+
+cl_mem oclBufferPool::acquire(size_t size, cl_mem_flags flags, cl_int* error)
+{
+	cl_int localError;
+	if(error == NULL)
+		error = &localError;
+
+	if( flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR) )
+	{
+		*error = CL_INVALID_VALUE;
+		return NULL;
+	}
+
+	const Key key(flags, sizeClass(size));
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.acquires++;
+
+		std::map< Key, std::vector<LruList::iterator> >::iterator list = m_freeLists.find(key);
+		// Most recently returned first; it is the most likely to still be resident.
+		// Buffers that enqueued commands still use are skipped.
+		size_t i = list != m_freeLists.end() ? list->second.size() : 0;
+		while( i > 0 && !oclEventDone(list->second[i - 1]->inUseUntil) )
+			i--;
+		if(i > 0)
+		{
+			LruList::iterator cached = list->second[i - 1];
+			list->second.erase(list->second.begin() + (i - 1));
+			cl_mem buffer = cached->buffer;
+			if(cached->inUseUntil != NULL)
+				clReleaseEvent(cached->inUseUntil);
+			m_lru.erase(cached);
+
+			m_stats.hits++;
+			m_stats.bytesCached -= key.size;
+			m_stats.bytesInUse += key.size;
+			m_inUse[buffer] = key;
+			*error = CL_SUCCESS;
+			return buffer;
+		}
+		m_stats.misses++;
+	}
+
+	cl_mem buffer = clCreateBuffer(m_context, flags, key.size, NULL, error);
+	if(*error == CL_MEM_OBJECT_ALLOCATION_FAILURE || *error == CL_OUT_OF_RESOURCES)
+	{
+		// Give the cached memory back to the driver and try once more.
+		trim(0);
+		buffer = clCreateBuffer(m_context, flags, key.size, NULL, error);
+	}
+	if( !oclHandleErrorMessage("Creating pooled buffer", *error) )
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.bytesInUse += key.size;
+	m_inUse[buffer] = key;
+	return buffer;
+}
+
+void oclBufferPool::release(cl_mem buffer, cl_event inUseUntil)
+{
+	if(buffer == NULL)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::unordered_map<cl_mem, Key>::iterator it = m_inUse.find(buffer);
+	if( it == m_inUse.end() )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Buffer returned to a pool it does not belong to, releasing it\n");
+		clReleaseMemObject(buffer);
+		return;
+	}
+
+	const Key key = it->second;
+	m_inUse.erase(it);
+	m_stats.bytesInUse -= key.size;
+
+	CachedBuffer cached;
+	cached.key = key;
+	cached.buffer = buffer;
+	cached.inUseUntil = inUseUntil;
+	if(inUseUntil != NULL)
+		clRetainEvent(inUseUntil);
+	m_freeLists[key].push_back(m_lru.insert(m_lru.end(), cached));
+	m_stats.bytesCached += key.size;
+
+	if(m_stats.bytesCached > m_highWaterBytes)
+		trimLocked(m_highWaterBytes);
+}
+
+void oclBufferPool::trim(cl_ulong targetBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	trimLocked(targetBytes);
+}
+
+void oclBufferPool::trimLocked(cl_ulong targetBytes)
+{
+	while( m_stats.bytesCached > targetBytes && !m_lru.empty() )
+	{
+		LruList::iterator oldest = m_lru.begin();
+		std::vector<LruList::iterator>& list = m_freeLists[oldest->key];
+		list.erase(std::find(list.begin(), list.end(), oldest));
+
+		// The driver keeps the buffer alive until commands still using it finish.
+		clReleaseMemObject(oldest->buffer);
+		if(oldest->inUseUntil != NULL)
+			clReleaseEvent(oldest->inUseUntil);
+		m_stats.bytesCached -= oldest->key.size;
+		m_stats.trimmed++;
+		m_lru.erase(oldest);
+	}
+}
+
+void oclBufferPool::setHighWaterBytes(cl_ulong highWaterBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_highWaterBytes = highWaterBytes;
+	trimLocked(m_highWaterBytes);
+}
+
+oclBufferPoolStats oclBufferPool::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+static std::mutex oclBufferPoolsMutex;
+static std::map<cl_context, oclBufferPool*> oclBufferPools;
+
+oclBufferPool* oclGetBufferPool(cl_context context)
+{
+	std::lock_guard<std::mutex> lock(oclBufferPoolsMutex);
+	oclBufferPool*& pool = oclBufferPools[context];
+	if(pool == NULL)
+		pool = new oclBufferPool(context);
+	return pool;
+}
+
+void oclReleaseBufferPool(cl_context context)
+{
+	oclBufferPool* pool = NULL;
+	{
+		std::lock_guard<std::mutex> lock(oclBufferPoolsMutex);
+		std::map<cl_context, oclBufferPool*>::iterator it = oclBufferPools.find(context);
+		if( it == oclBufferPools.end() )
+			return;
+		pool = it->second;
+		oclBufferPools.erase(it);
+	}
+	delete pool;
+}
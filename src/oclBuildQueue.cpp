@@ -0,0 +1,229 @@
+#include <stdio.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclBuildQueue.h>
+
+struct oclBuildState
+{
+	oclBuildPool* pool;
+	cl_program program;
+	std::vector<cl_device_id> devices;
+	std::string options;
+
+	std::mutex mutex;
+	std::condition_variable finished;
+	bool done;
+	cl_int status;
+	std::vector<std::string> logs;
+
+	// Keeps the state alive while the driver holds the raw pointer passed to pfn_notify.
+	std::shared_ptr<oclBuildState> self;
+
+	oclBuildState() : pool(NULL), program(NULL), done(false), status(CL_SUCCESS) {}
+	~oclBuildState()
+	{
+		if(program)
+			clReleaseProgram(program);
+	}
+
+	// Captures status and logs. Only the first call has an effect.
+	void complete(cl_int buildError)
+	{
+		std::shared_ptr<oclBuildState> keepAlive;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(done)
+				return;
+
+			status = buildError;
+			logs.resize(devices.size());
+			for(size_t i = 0; i < devices.size(); i++)
+			{
+				cl_build_status buildStatus = CL_BUILD_ERROR;
+				clGetProgramBuildInfo(program, devices[i], CL_PROGRAM_BUILD_STATUS, sizeof(buildStatus), &buildStatus, NULL);
+				if(buildStatus != CL_BUILD_SUCCESS && status == CL_SUCCESS)
+					status = CL_BUILD_PROGRAM_FAILURE;
+
+				size_t size = 0;
+				if( clGetProgramBuildInfo(program, devices[i], CL_PROGRAM_BUILD_LOG, 0, NULL, &size) == CL_SUCCESS && size > 0 )
+				{
+					std::vector<char> buffer(size + 1, '\0');
+					clGetProgramBuildInfo(program, devices[i], CL_PROGRAM_BUILD_LOG, size, &buffer[0], NULL);
+					logs[i] = &buffer[0];
+				}
+			}
+
+			done = true;
+			keepAlive.swap(self);
+		}
+		finished.notify_all();
+		pool->buildFinished();
+	}
+};
+
+static void oclBuildNotify(cl_program, void* userData)
+{
+	((oclBuildState*)userData)->complete(CL_SUCCESS);
+}
+
+bool oclBuildFuture::ready() const
+{
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	return m_state->done;
+}
+
+cl_int oclBuildFuture::wait() const
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	while(!m_state->done)
+		m_state->finished.wait(lock);
+	return m_state->status;
+}
+
+cl_program oclBuildFuture::program() const
+{
+	return m_state->program;
+}
+
+const std::vector<cl_device_id>& oclBuildFuture::devices() const
+{
+	return m_state->devices;
+}
+
+std::string oclBuildFuture::log(cl_device_id device) const
+{
+	wait();
+	for(size_t i = 0; i < m_state->devices.size(); i++)
+	{
+		if(m_state->devices[i] == device)
+			return m_state->logs[i];
+	}
+	return std::string();
+}
+
+void oclBuildFuture::printLog() const
+{
+	wait();
+	for(size_t i = 0; i < m_state->devices.size(); i++)
+		printf("BUILD LOG: \n %s", m_state->logs[i].c_str());
+}
+
+oclBuildPool::oclBuildPool(unsigned int threadCount)
+	: m_outstanding(0)
+	, m_stopping(false)
+{
+	if(threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if(threadCount == 0)
+		threadCount = 2;
+
+	for(unsigned int i = 0; i < threadCount; i++)
+		m_workers.push_back(std::thread(&oclBuildPool::workerLoop, this));
+}
+
+oclBuildPool::~oclBuildPool()
+{
+	waitAll();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_workAvailable.notify_all();
+	for(size_t i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+}
+
+oclBuildFuture oclBuildPool::submit(cl_program program, const cl_device_id* devices, cl_uint deviceCount, const char* options)
+{
+	std::shared_ptr<oclBuildState> state = std::make_shared<oclBuildState>();
+	state->pool = this;
+	state->program = program;
+	clRetainProgram(program);
+	if(options)
+		state->options = options;
+
+	if(deviceCount > 0)
+	{
+		state->devices.assign(devices, devices + deviceCount);
+	}
+	else
+	{
+		cl_uint programDevices = 0;
+		clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(programDevices), &programDevices, NULL);
+		state->devices.resize(programDevices);
+		if(programDevices > 0)
+			clGetProgramInfo(program, CL_PROGRAM_DEVICES, programDevices * sizeof(cl_device_id), &state->devices[0], NULL);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_outstanding++;
+		m_pending.push_back(state);
+	}
+	m_workAvailable.notify_one();
+	return oclBuildFuture(state);
+}
+
+std::vector<oclBuildFuture> oclBuildPool::submit(const cl_program* programs, size_t programCount,
+	const cl_device_id* devices, cl_uint deviceCount, const char* options)
+{
+	std::vector<oclBuildFuture> futures;
+	futures.reserve(programCount);
+	for(size_t i = 0; i < programCount; i++)
+		futures.push_back(submit(programs[i], devices, deviceCount, options));
+	return futures;
+}
+
+void oclBuildPool::waitAll()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(m_outstanding > 0)
+		m_idle.wait(lock);
+}
+
+void oclBuildPool::buildFinished()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(--m_outstanding == 0)
+		m_idle.notify_all();
+}
+
+void oclBuildPool::workerLoop()
+{
+	for(;;)
+	{
+		std::shared_ptr<oclBuildState> state;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while(m_pending.empty() && !m_stopping)
+				m_workAvailable.wait(lock);
+			if(m_pending.empty())
+				return;
+			state = m_pending.front();
+			m_pending.pop_front();
+		}
+
+		state->self = state;
+		cl_int error = clBuildProgram(state->program, (cl_uint)state->devices.size(),
+			state->devices.empty() ? NULL : &state->devices[0],
+			state->options.c_str(), oclBuildNotify, state.get());
+
+		// Errors reported before the build started never reach pfn_notify.
+		if(error != CL_SUCCESS)
+			state->complete(error);
+	}
+}
+
+oclBuildPool* oclGetDefaultBuildPool()
+{
+	static oclBuildPool* pool = NULL;
+	static std::once_flag once;
+	std::call_once(once, []() { pool = new oclBuildPool(); });
+	return pool;
+}
+
+oclBuildFuture oclBuildProgramAsync(cl_program program, const cl_device_id* devices, cl_uint deviceCount, const char* options)
+{
+	return oclGetDefaultBuildPool()->submit(program, devices, deviceCount, options);
+}
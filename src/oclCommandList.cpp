@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclCommandList.h>
+
+oclCommandList::oclCommandList()
+	: m_enqueuedCount(0)
+{
+}
+
+int oclCommandList::parameter(const char* name, size_t size)
+{
+	if(size == 0)
+		return -1;
+
+	int existing = find(name);
+	if(existing >= 0)
+	{
+		if(m_parameters[existing].value.size() == size)
+			return existing;
+		if(oclGetVerbosity() > 0)
+			printf("Command list parameter \"%s\" redeclared with a different size\n", name);
+		return -1;
+	}
+
+	Parameter parameter;
+	parameter.name = name;
+	parameter.value.assign(size, 0);
+	parameter.assigned = false;
+	m_parameters.push_back(parameter);
+	return (int)m_parameters.size() - 1;
+}
+
+int oclCommandList::find(const char* name) const
+{
+	for(size_t i = 0; i < m_parameters.size(); i++)
+	{
+		if(m_parameters[i].name == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+int oclCommandList::argState(cl_kernel kernel, cl_uint index, size_t size)
+{
+	for(size_t i = 0; i < m_args.size(); i++)
+	{
+		if(m_args[i].kernel == kernel && m_args[i].index == index)
+		{
+			// Room for the largest value, so replay never reallocates.
+			m_args[i].current.value.reserve(size);
+			return (int)i;
+		}
+	}
+
+	ArgState state;
+	state.kernel = kernel;
+	state.index = index;
+	state.current.value.reserve(size);
+	state.current.null = false;
+	state.known = false;
+	m_args.push_back(state);
+	return (int)m_args.size() - 1;
+}
+
+cl_int oclCommandList::recordArg(cl_kernel kernel, cl_uint index, size_t size, const void* value)
+{
+	// Set right away so the driver validates it once, here.
+	cl_int error = clSetKernelArg(kernel, index, size, value);
+	if( !oclHandleErrorMessage("Recording kernel argument", error) )
+		return error;
+
+	ArgValue constant;
+	constant.null = value == NULL;
+	if(value != NULL)
+		constant.value.assign((const unsigned char*)value, (const unsigned char*)value + size);
+	else
+		constant.value.resize(size);
+	m_constants.push_back(constant);
+
+	Command command = Command();
+	command.type = CommandArg;
+	command.pointerParameter = -1;
+	command.arg = argState(kernel, index, size);
+	command.constant = (int)m_constants.size() - 1;
+	command.valueParameter = -1;
+	m_commands.push_back(command);
+
+	// That is also what the kernel holds now.
+	ArgState& state = m_args[command.arg];
+	state.current.value = constant.value;
+	state.current.null = constant.null;
+	state.known = true;
+	return CL_SUCCESS;
+}
+
+cl_int oclCommandList::recordArgParameter(cl_kernel kernel, cl_uint index, int parameter)
+{
+	if(parameter < 0 || parameter >= (int)m_parameters.size())
+		return CL_INVALID_VALUE;
+
+	Command command = Command();
+	command.type = CommandArg;
+	command.pointerParameter = -1;
+	command.arg = argState(kernel, index, m_parameters[parameter].value.size());
+	command.constant = -1;
+	command.valueParameter = parameter;
+	m_commands.push_back(command);
+	return CL_SUCCESS;
+}
+
+cl_int oclCommandList::recordKernel(cl_kernel kernel, cl_uint workDim, const size_t* globalWorkSize,
+	const size_t* localWorkSize)
+{
+	if(workDim < 1 || workDim > 3)
+		return CL_INVALID_WORK_DIMENSION;
+
+	Command command = Command();
+	command.type = CommandKernel;
+	command.kernel = kernel;
+	command.workDim = workDim;
+	command.hasLocalWorkSize = localWorkSize != NULL;
+	for(cl_uint d = 0; d < workDim; d++)
+	{
+		command.globalWorkSize[d] = globalWorkSize[d];
+		command.localWorkSize[d] = localWorkSize ? localWorkSize[d] : 0;
+	}
+	command.pointerParameter = -1;
+	m_commands.push_back(command);
+	m_enqueuedCount++;
+	return CL_SUCCESS;
+}
+
+cl_int oclCommandList::recordWrite(cl_mem buffer, size_t offset, size_t size, const void* data)
+{
+	Command command = Command();
+	command.type = CommandWrite;
+	command.buffer = buffer;
+	command.offset = offset;
+	command.size = size;
+	command.source = data;
+	command.pointerParameter = -1;
+	m_commands.push_back(command);
+	m_enqueuedCount++;
+	return CL_SUCCESS;
+}
+
+cl_int oclCommandList::recordRead(cl_mem buffer, size_t offset, size_t size, void* data)
+{
+	Command command = Command();
+	command.type = CommandRead;
+	command.buffer = buffer;
+	command.offset = offset;
+	command.size = size;
+	command.target = data;
+	command.pointerParameter = -1;
+	m_commands.push_back(command);
+	m_enqueuedCount++;
+	return CL_SUCCESS;
+}
+
+cl_int oclCommandList::recordWriteParameter(cl_mem buffer, size_t offset, size_t size, int pointerParameter)
+{
+	if(pointerParameter < 0 || pointerParameter >= (int)m_parameters.size() ||
+		m_parameters[pointerParameter].value.size() != sizeof(void*))
+		return CL_INVALID_VALUE;
+
+	cl_int error = recordWrite(buffer, offset, size, NULL);
+	m_commands.back().pointerParameter = pointerParameter;
+	return error;
+}
+
+cl_int oclCommandList::recordReadParameter(cl_mem buffer, size_t offset, size_t size, int pointerParameter)
+{
+	if(pointerParameter < 0 || pointerParameter >= (int)m_parameters.size() ||
+		m_parameters[pointerParameter].value.size() != sizeof(void*))
+		return CL_INVALID_VALUE;
+
+	cl_int error = recordRead(buffer, offset, size, NULL);
+	m_commands.back().pointerParameter = pointerParameter;
+	return error;
+}
+
+cl_int oclCommandList::recordCopy(cl_mem source, size_t sourceOffset, cl_mem destination,
+	size_t destinationOffset, size_t size)
+{
+	Command command = Command();
+	command.type = CommandCopy;
+	command.buffer = source;
+	command.offset = sourceOffset;
+	command.destination = destination;
+	command.destinationOffset = destinationOffset;
+	command.size = size;
+	command.pointerParameter = -1;
+	m_commands.push_back(command);
+	m_enqueuedCount++;
+	return CL_SUCCESS;
+}
+
+cl_int oclCommandList::set(int parameter, const void* value, size_t size)
+{
+	if(parameter < 0 || parameter >= (int)m_parameters.size())
+		return CL_INVALID_VALUE;
+
+	Parameter& p = m_parameters[parameter];
+	if(size != p.value.size())
+		return CL_INVALID_ARG_SIZE;
+
+	// Replay compares against what the kernel holds, so unchanged values cost nothing.
+	memcpy(&p.value[0], value, size);
+	p.assigned = true;
+	return CL_SUCCESS;
+}
+
+const void* oclCommandList::pointerOf(const Command& command) const
+{
+	if(command.pointerParameter < 0)
+		return command.type == CommandWrite ? command.source : command.target;
+
+	const void* pointer;
+	memcpy(&pointer, &m_parameters[command.pointerParameter].value[0], sizeof(pointer));
+	return pointer;
+}
+
+cl_int oclCommandList::applyArg(const Command& command)
+{
+	const unsigned char* value;
+	size_t size;
+	bool null = false;
+	if(command.valueParameter >= 0)
+	{
+		const Parameter& p = m_parameters[command.valueParameter];
+		value = &p.value[0];
+		size = p.value.size();
+	}
+	else
+	{
+		const ArgValue& constant = m_constants[command.constant];
+		value = constant.value.empty() ? NULL : &constant.value[0];
+		size = constant.value.size();
+		null = constant.null;
+	}
+
+	ArgState& state = m_args[command.arg];
+	if( state.known && state.current.null == null && state.current.value.size() == size &&
+		(size == 0 || memcmp(&state.current.value[0], value, size) == 0) )
+		return CL_SUCCESS;
+
+	cl_int error = clSetKernelArg(state.kernel, state.index, size, null ? NULL : value);
+	state.known = error == CL_SUCCESS;
+	if(state.known)
+	{
+		state.current.value.assign(value, value + size);
+		state.current.null = null;
+	}
+	return error;
+}
+
+cl_int oclCommandList::replay(cl_command_queue queue, cl_uint waitCount, const cl_event* waitList, cl_event* event)
+{
+	// A launch must not silently run with whatever the argument held before.
+	for(size_t i = 0; i < m_commands.size(); i++)
+	{
+		const Command& c = m_commands[i];
+		if(c.type == CommandArg && c.valueParameter >= 0 && !m_parameters[c.valueParameter].assigned)
+		{
+			oclHandleErrorMessage("Replaying command list with an unset parameter", CL_INVALID_KERNEL_ARGS);
+			return CL_INVALID_KERNEL_ARGS;
+		}
+	}
+
+	cl_int error = CL_SUCCESS;
+	if(m_enqueuedCount == 0 && event != NULL)
+		error = clEnqueueMarker(queue, event);
+
+	size_t enqueued = 0;
+	for(size_t i = 0; i < m_commands.size() && error == CL_SUCCESS; i++)
+	{
+		const Command& c = m_commands[i];
+		if(c.type == CommandArg)
+		{
+			error = applyArg(c);
+			continue;
+		}
+
+		const cl_uint waits = enqueued == 0 ? waitCount : 0;
+		const cl_event* waitEvents = enqueued == 0 ? waitList : NULL;
+		enqueued++;
+		cl_event* signal = enqueued == m_enqueuedCount ? event : NULL;
+
+		switch(c.type)
+		{
+		case CommandKernel:
+			error = clEnqueueNDRangeKernel(queue, c.kernel, c.workDim, NULL, c.globalWorkSize,
+				c.hasLocalWorkSize ? c.localWorkSize : NULL, waits, waitEvents, signal);
+			break;
+		case CommandWrite:
+			error = clEnqueueWriteBuffer(queue, c.buffer, CL_FALSE, c.offset, c.size, pointerOf(c),
+				waits, waitEvents, signal);
+			break;
+		case CommandRead:
+			error = clEnqueueReadBuffer(queue, c.buffer, CL_FALSE, c.offset, c.size, (void*)pointerOf(c),
+				waits, waitEvents, signal);
+			break;
+		case CommandCopy:
+			error = clEnqueueCopyBuffer(queue, c.buffer, c.destination, c.offset, c.destinationOffset, c.size,
+				waits, waitEvents, signal);
+			break;
+		case CommandArg:
+			break;
+		}
+	}
+	oclHandleErrorMessage("Replaying command list", error);
+	return error;
+}
+
+void oclCommandList::invalidate()
+{
+	for(size_t i = 0; i < m_args.size(); i++)
+		m_args[i].known = false;
+}
+
+void oclCommandList::clear()
+{
+	m_commands.clear();
+	m_parameters.clear();
+	m_constants.clear();
+	m_args.clear();
+	m_enqueuedCount = 0;
+}
@@ -0,0 +1,32 @@
+#ifdef _WIN32
+#  include "oclWindows.h"
+#else
+#  ifndef _GNU_SOURCE
+#    define _GNU_SOURCE
+#  endif
+#  include <dlfcn.h>
+#endif
+
+#include "oclCompat.h"
+
+static void* oclResolveEntryPoint(const char* name)
+{
+#ifdef _WIN32
+	HMODULE library = GetModuleHandleA("OpenCL.dll");
+	return library ? (void*)GetProcAddress(library, name) : NULL;
+#else
+	return dlsym(RTLD_DEFAULT, name);
+#endif
+}
+
+oclCreateSubBufferFn oclGetCreateSubBuffer()
+{
+	static oclCreateSubBufferFn function = (oclCreateSubBufferFn)oclResolveEntryPoint("clCreateSubBuffer");
+	return function;
+}
+
+oclSetEventCallbackFn oclGetSetEventCallback()
+{
+	static oclSetEventCallbackFn function = (oclSetEventCallbackFn)oclResolveEntryPoint("clSetEventCallback");
+	return function;
+}
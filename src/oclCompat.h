@@ -0,0 +1,41 @@
+#ifndef OCL_COMPAT_H
+#define OCL_COMPAT_H
+
+// Internal access to OpenCL 1.1+ entry points. The bundled headers are 1.0, so
+// these are declared here and resolved from the loaded OpenCL library at
+// runtime. Callers must still check the device/platform version, since an ICD
+// loader may export a function its platform doesn't implement.
+
+#include <CL/cl.h>
+
+#ifndef CL_CALLBACK
+#  ifdef _WIN32
+#    define CL_CALLBACK __stdcall
+#  else
+#    define CL_CALLBACK
+#  endif
+#endif
+
+#ifndef CL_VERSION_1_1
+typedef cl_uint cl_buffer_create_type;
+typedef struct _cl_buffer_region
+{
+	size_t origin;
+	size_t size;
+} cl_buffer_region;
+
+#define CL_BUFFER_CREATE_TYPE_REGION 0x1220
+#define CL_DEVICE_HOST_UNIFIED_MEMORY 0x1035
+#define CL_MISALIGNED_SUB_BUFFER_OFFSET -13
+#endif
+
+typedef cl_mem (CL_API_CALL *oclCreateSubBufferFn)(cl_mem buffer, cl_mem_flags flags,
+	cl_buffer_create_type type, const void* info, cl_int* error);
+typedef cl_int (CL_API_CALL *oclSetEventCallbackFn)(cl_event event, cl_int type,
+	void (CL_CALLBACK *notify)(cl_event, cl_int, void*), void* userData);
+
+// NULL if the loaded library doesn't export the function.
+oclCreateSubBufferFn oclGetCreateSubBuffer();
+oclSetEventCallbackFn oclGetSetEventCallback();
+
+#endif
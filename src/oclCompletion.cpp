@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <memory>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclCompletion.h>
+#include "oclCompat.h"
+
+// Continuation registered through clSetEventCallback.
+struct oclCompletionEntry
+{
+	oclCompletionService* service;
+	cl_event event;
+	oclCompletionCallback continuation;
+};
+
+struct oclCompletionCallbacks
+{
+	// Exceptions must not escape into the driver's C frames or end the polling
+	// thread; they are dropped and the entry is retired all the same.
+	static void run(const oclCompletionCallback& continuation, cl_int status)
+	{
+		try
+		{
+			continuation(status);
+		}
+		catch(const std::exception& e)
+		{
+			if(oclGetVerbosity() > 0)
+				printf("Completion continuation threw an exception: %s\n", e.what());
+		}
+		catch(...)
+		{
+			if(oclGetVerbosity() > 0)
+				printf("Completion continuation threw an exception\n");
+		}
+	}
+
+	static void CL_CALLBACK notify(cl_event, cl_int status, void* data)
+	{
+		oclCompletionEntry* entry = (oclCompletionEntry*)data;
+		run(entry->continuation, status);
+		clReleaseEvent(entry->event);
+		entry->service->retire(1);
+		delete entry;
+	}
+};
+
+oclCompletionService::oclCompletionService()
+	: m_stopping(false)
+	, m_outstanding(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+oclCompletionService::~oclCompletionService()
+{
+	drain();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_work.notify_all();
+	if( m_pollThread.joinable() )
+		m_pollThread.join();
+}
+
+bool oclCompletionService::useCallback(cl_event event) const
+{
+	if(oclGetSetEventCallback() == NULL)
+		return false;
+
+	cl_command_queue queue = NULL;
+	if(clGetEventInfo(event, CL_EVENT_COMMAND_QUEUE, sizeof(queue), &queue, NULL) != CL_SUCCESS)
+		return false;
+	// Only user events have no queue, and those need 1.1 anyway.
+	if(queue == NULL)
+		return true;
+
+	cl_device_id device = NULL;
+	if(clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL) != CL_SUCCESS)
+		return false;
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	return info != NULL && info->versionAtLeast(1, 1);
+}
+
+bool oclCompletionService::then(cl_event event, const oclCompletionCallback& continuation)
+{
+	cl_int status;
+	cl_int error = clGetEventInfo(event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+	if( !oclHandleErrorMessage("Registering completion", error) )
+		return false;
+
+	// Unflushed commands might never start, neither for callbacks nor for polling.
+	cl_command_queue queue = NULL;
+	if(clGetEventInfo(event, CL_EVENT_COMMAND_QUEUE, sizeof(queue), &queue, NULL) == CL_SUCCESS && queue != NULL)
+		clFlush(queue);
+
+	clRetainEvent(event);
+	if( useCallback(event) )
+	{
+		oclCompletionEntry* entry = new oclCompletionEntry;
+		entry->service = this;
+		entry->event = event;
+		entry->continuation = continuation;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_outstanding++;
+			m_stats.callbacks++;
+		}
+		// May call back right away if event already completed.
+		error = oclGetSetEventCallback()(event, CL_COMPLETE, oclCompletionCallbacks::notify, entry);
+		if(error == CL_SUCCESS)
+			return true;
+
+		if(oclGetVerbosity() > 0)
+			printf("clSetEventCallback failed (%s), polling instead\n", oclErrorString(error));
+		delete entry;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_outstanding--;
+		m_stats.callbacks--;
+	}
+
+	Pending pending;
+	pending.event = event;
+	pending.continuation = continuation;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_outstanding++;
+		m_stats.polled++;
+		m_incoming.push_back(pending);
+		if( !m_pollThread.joinable() )
+			m_pollThread = std::thread(&oclCompletionService::pollLoop, this);
+	}
+	m_work.notify_one();
+	return true;
+}
+
+std::future<int> oclCompletionService::future(cl_event event)
+{
+	std::shared_ptr< std::promise<int> > promise(new std::promise<int>);
+	std::future<int> result = promise->get_future();
+	if( !then(event, [promise](int status) { promise->set_value(status); }) )
+		promise->set_value(CL_INVALID_EVENT);
+	return result;
+}
+
+void oclCompletionService::pollLoop()
+{
+	std::vector<Pending> watching;
+	long delay = OCL_UTIL_COMPLETION_MIN_POLL_US;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for(;;)
+	{
+		if( !m_incoming.empty() )
+		{
+			watching.insert(watching.end(), m_incoming.begin(), m_incoming.end());
+			m_incoming.clear();
+			delay = OCL_UTIL_COMPLETION_MIN_POLL_US;
+		}
+		if( watching.empty() )
+		{
+			if(m_stopping)
+				return;
+			m_work.wait(lock, [this] { return m_stopping || !m_incoming.empty(); });
+			continue;
+		}
+		lock.unlock();
+
+		size_t completed = 0;
+		const size_t polls = watching.size();
+		for(size_t i = 0; i < watching.size(); )
+		{
+			cl_int status;
+			cl_int error = clGetEventInfo(watching[i].event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+			if(error != CL_SUCCESS)
+				status = error;
+			if(status > CL_COMPLETE)
+			{
+				i++;
+				continue;
+			}
+
+			oclCompletionCallbacks::run(watching[i].continuation, status);
+			clReleaseEvent(watching[i].event);
+			std::swap(watching[i], watching.back());
+			watching.pop_back();
+			completed++;
+		}
+
+		lock.lock();
+		m_stats.polls += polls;
+		if(completed > 0)
+		{
+			m_outstanding -= completed;
+			m_drained.notify_all();
+			delay = OCL_UTIL_COMPLETION_MIN_POLL_US;
+		}
+		else
+			delay = std::min(delay * 2, (long)OCL_UTIL_COMPLETION_MAX_POLL_US);
+
+		// New registrations cut the sleep short.
+		if( !watching.empty() )
+			m_work.wait_for(lock, std::chrono::microseconds(delay), [this] { return !m_incoming.empty(); });
+	}
+}
+
+void oclCompletionService::retire(size_t count)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_outstanding -= count;
+	m_drained.notify_all();
+}
+
+void oclCompletionService::drain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_drained.wait(lock, [this] { return m_outstanding == 0; });
+}
+
+size_t oclCompletionService::outstanding() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_outstanding;
+}
+
+oclCompletionStats oclCompletionService::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+static std::mutex oclCompletionMutex;
+static oclCompletionService* oclCompletion = NULL;
+
+oclCompletionService* oclGetCompletionService()
+{
+	std::lock_guard<std::mutex> lock(oclCompletionMutex);
+	if(oclCompletion == NULL)
+		oclCompletion = new oclCompletionService;
+	return oclCompletion;
+}
+
+void oclReleaseCompletionService()
+{
+	oclCompletionService* service;
+	{
+		std::lock_guard<std::mutex> lock(oclCompletionMutex);
+		service = oclCompletion;
+		oclCompletion = NULL;
+	}
+	delete service;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclContext.h>
+#include <oclRegistry.h>
+
+oclContext::~oclContext()
+{
+	oclReleaseContext(this);
+}
+
+cl_command_queue oclContext::queueFor(cl_device_id device) const
+{
+	for(size_t i = 0; i < devices.size(); i++)
+	{
+		if(devices[i] == device)
+			return queues[i];
+	}
+	return NULL;
+}
+
+bool oclCreateMultiDeviceContext(oclContext* context, cl_platform_id platformId,
+	cl_device_type deviceType, cl_command_queue_properties queueProperties)
+{
+	const std::vector<cl_device_id> devices = oclGetRegistry()->devices(platformId, deviceType);
+	const cl_uint deviceCount = (cl_uint)devices.size();
+	if(deviceCount == 0)
+	{
+		if(oclGetVerbosity() > 0)
+			printf("No devices of the requested type found on platform\n");
+		return false;
+	}
+
+	return oclCreateMultiDeviceContext(context, platformId, &devices[0], deviceCount, queueProperties);
+}
+
+bool oclCreateMultiDeviceContext(oclContext* context, cl_platform_id platformId,
+	const cl_device_id* devices, cl_uint deviceCount, cl_command_queue_properties queueProperties)
+{
+	cl_int error;
+
+	oclReleaseContext(context);
+	if(deviceCount == 0)
+		return false;
+
+	cl_context_properties props[] =
+	{
+		CL_CONTEXT_PLATFORM, (cl_context_properties)platformId,
+		0
+	};
+
+	context->context = clCreateContext(props, deviceCount, devices, NULL, NULL, &error);
+	if( !oclHandleErrorMessage("Creating multi-device CL context", error) )
+	{
+		context->context = NULL;
+		return false;
+	}
+	context->platform = platformId;
+	context->devices.assign(devices, devices + deviceCount);
+
+	// Queues are always in-order; cross-device ordering is expressed with events.
+	queueProperties &= ~(cl_command_queue_properties)CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+	for(cl_uint i = 0; i < deviceCount; i++)
+	{
+		cl_command_queue queue = clCreateCommandQueue(context->context, devices[i], queueProperties, &error);
+		if( !oclHandleErrorMessage("Creating command queue", error) )
+		{
+			oclReleaseContext(context);
+			return false;
+		}
+		context->queues.push_back(queue);
+	}
+
+	return true;
+}
+
+void oclReleaseContext(oclContext* context)
+{
+	for(size_t i = 0; i < context->queues.size(); i++)
+		clReleaseCommandQueue(context->queues[i]);
+	context->queues.clear();
+	context->devices.clear();
+
+	if(context->context != NULL)
+		clReleaseContext(context->context);
+	context->context = NULL;
+	context->platform = NULL;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <CL/cl.h>
+#include <oclDeviceInfo.h>
+#include "oclCompat.h"
+
+// This constant isn't #defined in 1.0
+#ifndef CL_DEVICE_OPENCL_C_VERSION
+#define CL_DEVICE_OPENCL_C_VERSION 0x103D
+#endif
+
+template<typename T>
+static void oclQueryDeviceValue(cl_device_id device, cl_device_info param, T* value)
+{
+	if( clGetDeviceInfo(device, param, sizeof(T), value, NULL) != CL_SUCCESS )
+		*value = T();
+}
+
+static std::string oclQueryDeviceString(cl_device_id device, cl_device_info param)
+{
+	size_t size = 0;
+	if( clGetDeviceInfo(device, param, 0, NULL, &size) != CL_SUCCESS || size == 0 )
+		return std::string();
+
+	std::vector<char> buffer(size + 1, '\0');
+	if( clGetDeviceInfo(device, param, size, &buffer[0], NULL) != CL_SUCCESS )
+		return std::string();
+
+	return std::string(&buffer[0]);
+}
+
+static bool oclFillDeviceInfo(cl_device_id device, oclDeviceInfo* info)
+{
+	// Use the type query to check that the device is valid at all.
+	if( clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(info->type), &info->type, NULL) != CL_SUCCESS )
+		return false;
+
+	info->device = device;
+	oclQueryDeviceValue(device, CL_DEVICE_PLATFORM, &info->platform);
+
+	info->name = oclQueryDeviceString(device, CL_DEVICE_NAME);
+	info->vendor = oclQueryDeviceString(device, CL_DEVICE_VENDOR);
+	info->driverVersion = oclQueryDeviceString(device, CL_DRIVER_VERSION);
+	info->deviceVersion = oclQueryDeviceString(device, CL_DEVICE_VERSION);
+	info->extensions = oclQueryDeviceString(device, CL_DEVICE_EXTENSIONS);
+
+	info->versionMajor = 1;
+	info->versionMinor = 0;
+	sscanf(info->deviceVersion.c_str(), "OpenCL %d.%d", &info->versionMajor, &info->versionMinor);
+
+	// CL_DEVICE_OPENCL_C_VERSION and CL_DEVICE_HOST_UNIFIED_MEMORY are only valid on devices newer than 1.0
+	info->hostUnifiedMemory = CL_FALSE;
+	if( info->versionAtLeast(1, 1) )
+	{
+		info->openclCVersion = oclQueryDeviceString(device, CL_DEVICE_OPENCL_C_VERSION);
+		oclQueryDeviceValue(device, CL_DEVICE_HOST_UNIFIED_MEMORY, &info->hostUnifiedMemory);
+	}
+
+	oclQueryDeviceValue(device, CL_DEVICE_MAX_COMPUTE_UNITS, &info->computeUnits);
+	oclQueryDeviceValue(device, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, &info->maxWorkItemDimensions);
+	memset(info->maxWorkItemSizes, 0, sizeof(info->maxWorkItemSizes));
+	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(info->maxWorkItemSizes), info->maxWorkItemSizes, NULL);
+	oclQueryDeviceValue(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, &info->maxWorkGroupSize);
+	oclQueryDeviceValue(device, CL_DEVICE_MAX_CLOCK_FREQUENCY, &info->maxClockFrequency);
+	oclQueryDeviceValue(device, CL_DEVICE_ADDRESS_BITS, &info->addressBits);
+	oclQueryDeviceValue(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, &info->memBaseAddrAlign);
+	oclQueryDeviceValue(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, &info->maxMemAllocSize);
+	oclQueryDeviceValue(device, CL_DEVICE_GLOBAL_MEM_SIZE, &info->globalMemSize);
+	oclQueryDeviceValue(device, CL_DEVICE_ERROR_CORRECTION_SUPPORT, &info->errorCorrectionSupport);
+	oclQueryDeviceValue(device, CL_DEVICE_LOCAL_MEM_TYPE, &info->localMemType);
+	oclQueryDeviceValue(device, CL_DEVICE_LOCAL_MEM_SIZE, &info->localMemSize);
+	oclQueryDeviceValue(device, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, &info->maxConstantBufferSize);
+	oclQueryDeviceValue(device, CL_DEVICE_QUEUE_PROPERTIES, &info->queueProperties);
+	oclQueryDeviceValue(device, CL_DEVICE_IMAGE_SUPPORT, &info->imageSupport);
+	oclQueryDeviceValue(device, CL_DEVICE_MAX_READ_IMAGE_ARGS, &info->maxReadImageArgs);
+	oclQueryDeviceValue(device, CL_DEVICE_MAX_WRITE_IMAGE_ARGS, &info->maxWriteImageArgs);
+	oclQueryDeviceValue(device, CL_DEVICE_SINGLE_FP_CONFIG, &info->singleFpConfig);
+	oclQueryDeviceValue(device, CL_DEVICE_IMAGE2D_MAX_WIDTH, &info->image2dMaxWidth);
+	oclQueryDeviceValue(device, CL_DEVICE_IMAGE2D_MAX_HEIGHT, &info->image2dMaxHeight);
+	oclQueryDeviceValue(device, CL_DEVICE_IMAGE3D_MAX_WIDTH, &info->image3dMaxWidth);
+	oclQueryDeviceValue(device, CL_DEVICE_IMAGE3D_MAX_HEIGHT, &info->image3dMaxHeight);
+	oclQueryDeviceValue(device, CL_DEVICE_IMAGE3D_MAX_DEPTH, &info->image3dMaxDepth);
+
+	oclQueryDeviceValue(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR, &info->preferredVectorWidth[0]);
+	oclQueryDeviceValue(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT, &info->preferredVectorWidth[1]);
+	oclQueryDeviceValue(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT, &info->preferredVectorWidth[2]);
+	oclQueryDeviceValue(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG, &info->preferredVectorWidth[3]);
+	oclQueryDeviceValue(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT, &info->preferredVectorWidth[4]);
+	oclQueryDeviceValue(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE, &info->preferredVectorWidth[5]);
+
+	return true;
+}
+
+bool oclDeviceInfo::hasExtension(const char* extension) const
+{
+	const size_t length = strlen(extension);
+	size_t pos = 0;
+	while( (pos = extensions.find(extension, pos)) != std::string::npos )
+	{
+		const bool startOk = pos == 0 || extensions[pos - 1] == ' ';
+		const bool endOk = pos + length == extensions.size() || extensions[pos + length] == ' ';
+		if( startOk && endOk )
+			return true;
+		pos += length;
+	}
+	return false;
+}
+
+bool oclDeviceInfo::versionAtLeast(int major, int minor) const
+{
+	return versionMajor > major || (versionMajor == major && versionMinor >= minor);
+}
+
+bool oclDeviceInfo::sharesHostMemory() const
+{
+	return (type & CL_DEVICE_TYPE_CPU) != 0 || hostUnifiedMemory == CL_TRUE;
+}
+
+const oclDeviceInfo* oclGetDeviceInfo(cl_device_id device)
+{
+	// Entries are never removed, so returned pointers stay valid.
+	static std::mutex cacheMutex;
+	static std::map<cl_device_id, oclDeviceInfo*> cache;
+
+	if(device == NULL)
+		return NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		std::map<cl_device_id, oclDeviceInfo*>::iterator it = cache.find(device);
+		if( it != cache.end() )
+			return it->second;
+	}
+
+	// Query without holding the lock so that devices can be probed concurrently.
+	oclDeviceInfo* info = new oclDeviceInfo();
+	if( !oclFillDeviceInfo(device, info) )
+	{
+		delete info;
+		return NULL;
+	}
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	std::pair<std::map<cl_device_id, oclDeviceInfo*>::iterator, bool> inserted = cache.insert(std::make_pair(device, info));
+	if( !inserted.second )
+		delete info; // another thread filled it first
+	return inserted.first->second;
+}
@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceSelect.h>
+#include <oclHandles.h>
+#include <oclRegistry.h>
+
+static const char* oclBenchmarkSource =
+	"__kernel void oclBenchmark(__global float* out, float a, float b)\n"
+	"{\n"
+	"	float x = (float)get_global_id(0);\n"
+	"	float y = 1.0f;\n"
+	"	for(int i = 0; i < 256; ++i)\n"
+	"	{\n"
+	"		x = mad(x, a, b);\n"
+	"		y = mad(y, b, a);\n"
+	"	}\n"
+	"	out[get_global_id(0)] = x + y;\n"
+	"}\n";
+
+// 256 iterations of two mads (2 flops each)
+static const double oclBenchmarkFlopsPerItem = 256.0 * 4.0;
+
+static bool oclContainsNoCase(const std::string& haystack, const char* needle)
+{
+	std::string h(haystack), n(needle);
+	std::transform(h.begin(), h.end(), h.begin(), ::tolower);
+	std::transform(n.begin(), n.end(), n.begin(), ::tolower);
+	return h.find(n) != std::string::npos;
+}
+
+static std::string oclPlatformName(cl_platform_id platform)
+{
+	const oclPlatformEntry* entry = oclGetRegistry()->findPlatform(platform);
+	return entry ? entry->name : std::string();
+}
+
+static bool oclHasRequiredExtensions(const oclDeviceInfo* info, const char* requiredExtensions)
+{
+	if(requiredExtensions == NULL)
+		return true;
+
+	std::string list(requiredExtensions);
+	size_t pos = 0;
+	while( pos < list.size() )
+	{
+		size_t end = list.find(' ', pos);
+		if(end == std::string::npos)
+			end = list.size();
+		if( end > pos && !info->hasExtension(list.substr(pos, end - pos).c_str()) )
+			return false;
+		pos = end + 1;
+	}
+	return true;
+}
+
+// Rough peak estimate: compute units x clock x lanes per compute unit x 2 (mad).
+static double oclEstimateThroughput(const oclDeviceInfo* info)
+{
+	double lanes = 1.0;
+	if( info->type & CL_DEVICE_TYPE_GPU )
+		lanes = 32.0;
+	else if( info->type & CL_DEVICE_TYPE_ACCELERATOR )
+		lanes = 16.0;
+	else
+		lanes = info->preferredVectorWidth[4] > 0 ? (double)info->preferredVectorWidth[4] : 1.0;
+
+	return (double)info->computeUnits * (double)info->maxClockFrequency * lanes * 2.0 / 1000.0;
+}
+
+// Runs a short arithmetic kernel and returns the measured GFLOP/s, or 0 on failure.
+static double oclMeasureThroughput(const oclDeviceInfo* info)
+{
+	cl_int error;
+	ocl::Context context(clCreateContext(NULL, 1, &info->device, NULL, NULL, &error));
+	if(error != CL_SUCCESS)
+		return 0.0;
+
+	ocl::Queue queue(clCreateCommandQueue(context, info->device, 0, &error));
+	if(error != CL_SUCCESS)
+		return 0.0;
+
+	ocl::Program program(clCreateProgramWithSource(context, 1, &oclBenchmarkSource, NULL, &error));
+	if(error != CL_SUCCESS || clBuildProgram(program, 1, &info->device, NULL, NULL, NULL) != CL_SUCCESS)
+		return 0.0;
+
+	ocl::Kernel kernel(clCreateKernel(program, "oclBenchmark", &error));
+	if(error != CL_SUCCESS)
+		return 0.0;
+
+	size_t local = info->maxWorkGroupSize < 64 ? info->maxWorkGroupSize : 64;
+	size_t global = local * (info->computeUnits > 0 ? info->computeUnits : 1) * 64;
+	ocl::Buffer out(clCreateBuffer(context, CL_MEM_WRITE_ONLY, global * sizeof(cl_float), NULL, &error));
+	if(error != CL_SUCCESS)
+		return 0.0;
+
+	cl_mem outMem = out;
+	cl_float a = 0.999f, b = 0.001f;
+	clSetKernelArg(kernel, 0, sizeof(cl_mem), &outMem);
+	clSetKernelArg(kernel, 1, sizeof(cl_float), &a);
+	clSetKernelArg(kernel, 2, sizeof(cl_float), &b);
+
+	// First launch pays for lazy initialisation, time the second one.
+	error = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+	if(error == CL_SUCCESS)
+		error = clFinish(queue);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if(error == CL_SUCCESS)
+		error = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+	if(error == CL_SUCCESS)
+		error = clFinish(queue);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if(error != CL_SUCCESS || seconds <= 0.0)
+		return 0.0;
+	return (double)global * oclBenchmarkFlopsPerItem / seconds * 1e-9;
+}
+
+// Benchmark results per device, measured at most once per process.
+static std::mutex oclThroughputMutex;
+static std::condition_variable oclThroughputMeasured;
+static std::map<cl_device_id, double> oclMeasuredThroughput;
+// Stored while a thread runs the benchmark of a device.
+static const double oclThroughputMeasuring = -1.0;
+
+double oclGetDeviceThroughput(cl_device_id device, bool measure)
+{
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	if(info == NULL)
+		return 0.0;
+
+	double throughput = 0.0;
+	if(measure)
+	{
+		std::unique_lock<std::mutex> lock(oclThroughputMutex);
+		std::map<cl_device_id, double>::const_iterator cached;
+		for(;;)
+		{
+			cached = oclMeasuredThroughput.find(device);
+			if( cached == oclMeasuredThroughput.end() || cached->second != oclThroughputMeasuring )
+				break;
+			oclThroughputMeasured.wait(lock);
+		}
+
+		if( cached != oclMeasuredThroughput.end() )
+			throughput = cached->second;
+		else
+		{
+			// Benchmark without the lock so other devices are measured concurrently.
+			oclMeasuredThroughput[device] = oclThroughputMeasuring;
+			lock.unlock();
+			throughput = oclMeasureThroughput(info);
+			lock.lock();
+			oclMeasuredThroughput[device] = throughput;
+			oclThroughputMeasured.notify_all();
+		}
+	}
+	// Failed measurements are cached as 0 too and fall back to the estimate.
+	if(throughput <= 0.0)
+		throughput = oclEstimateThroughput(info);
+	return throughput;
+}
+
+static double oclScoreDevice(const oclDeviceInfo* info, double throughput)
+{
+	// Memory capacity acts as a multiplier so that it breaks ties between similar
+	// devices without letting a large but slow device win.
+	const double globalMB = (double)(info->globalMemSize >> 20);
+	const double localKB = (double)(info->localMemSize >> 10);
+	double memoryFactor = 1.0 + 0.1 * log(1.0 + globalMB / 256.0) / log(2.0);
+	if( info->localMemType == CL_LOCAL )
+		memoryFactor += 0.05 * log(1.0 + localKB / 16.0) / log(2.0);
+
+	return throughput * memoryFactor;
+}
+
+// Applies OCL_UTIL_DEVICE_ENV to the ranked list. Device type keywords drop
+// the other devices, names and indices move the matches to the front.
+static void oclApplyEnvironmentOverride(std::vector<oclDeviceCandidate>* ranked)
+{
+	const char* value = getenv(OCL_UTIL_DEVICE_ENV);
+	if(value == NULL || *value == '\0')
+		return;
+
+	std::vector<oclDeviceCandidate> matched, rest;
+	unsigned int platformIndex, deviceIndex;
+	char trailing;
+	const bool byIndex = sscanf(value, "%u:%u%c", &platformIndex, &deviceIndex, &trailing) == 2;
+	bool byType = false;
+
+	for(size_t i = 0; i < ranked->size(); i++)
+	{
+		const oclDeviceCandidate& c = (*ranked)[i];
+		bool match;
+		if(byIndex)
+			match = c.platformIndex == platformIndex && c.deviceIndex == deviceIndex;
+		else if( strcmp(value, "gpu") == 0 || strcmp(value, "GPU") == 0 )
+		{
+			match = (c.info->type & CL_DEVICE_TYPE_GPU) != 0;
+			byType = true;
+		}
+		else if( strcmp(value, "cpu") == 0 || strcmp(value, "CPU") == 0 )
+		{
+			match = (c.info->type & CL_DEVICE_TYPE_CPU) != 0;
+			byType = true;
+		}
+		else if( strcmp(value, "accelerator") == 0 || strcmp(value, "ACCELERATOR") == 0 )
+		{
+			match = (c.info->type & CL_DEVICE_TYPE_ACCELERATOR) != 0;
+			byType = true;
+		}
+		else
+			match = oclContainsNoCase(c.info->name, value) || oclContainsNoCase(oclPlatformName(c.platform), value);
+
+		(match ? matched : rest).push_back(c);
+	}
+
+	if( matched.empty() )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("%s=\"%s\" matched no device, using default ranking.\n", OCL_UTIL_DEVICE_ENV, value);
+		return;
+	}
+
+	if( !byType )
+		matched.insert(matched.end(), rest.begin(), rest.end());
+	ranked->swap(matched);
+}
+
+bool oclRankDevices(std::vector<oclDeviceCandidate>* ranked, const oclDeviceSelectOptions* options)
+{
+	const oclDeviceSelectOptions defaults;
+	if(options == NULL)
+		options = &defaults;
+
+	ranked->clear();
+
+	const oclRegistry* registry = oclGetRegistry();
+	if(registry->error != CL_SUCCESS)
+		return false;
+	if( registry->platforms.empty() )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("No OpenCL platform was found!\n");
+		return false;
+	}
+
+	for(cl_uint p = 0; p < registry->platforms.size(); p++)
+	{
+		const oclPlatformEntry& platform = registry->platforms[p];
+		for(cl_uint d = 0; d < platform.devices.size(); d++)
+		{
+			const oclDeviceInfo* info = platform.deviceInfo[d];
+			if( !(info->type & options->deviceTypes) || !oclHasRequiredExtensions(info, options->requiredExtensions) )
+				continue;
+
+			oclDeviceCandidate candidate;
+			candidate.platform = platform.platform;
+			candidate.device = platform.devices[d];
+			candidate.info = info;
+			candidate.platformIndex = p;
+			candidate.deviceIndex = d;
+			candidate.throughput = oclGetDeviceThroughput(candidate.device, options->runBenchmark);
+			candidate.score = oclScoreDevice(info, candidate.throughput);
+			ranked->push_back(candidate);
+		}
+	}
+
+	const cl_device_type preferred = options->preferredTypes;
+	std::stable_sort(ranked->begin(), ranked->end(),
+		[preferred](const oclDeviceCandidate& a, const oclDeviceCandidate& b)
+		{
+			const bool aPreferred = (a.info->type & preferred) != 0;
+			const bool bPreferred = (b.info->type & preferred) != 0;
+			if(aPreferred != bPreferred)
+				return aPreferred;
+			return a.score > b.score;
+		});
+
+	if(options->allowEnvironmentOverride)
+		oclApplyEnvironmentOverride(ranked);
+
+	if( ranked->empty() )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("No OpenCL device matched the selection criteria!\n");
+		return false;
+	}
+	return true;
+}
+
+bool oclSelectDevice(cl_platform_id* platformId, cl_device_id* deviceId, const oclDeviceSelectOptions* options)
+{
+	std::vector<oclDeviceCandidate> ranked;
+	if( !oclRankDevices(&ranked, options) )
+		return false;
+
+	*platformId = ranked[0].platform;
+	*deviceId = ranked[0].device;
+	// A success, so it is only reported at the level that traces successful calls.
+	if(oclGetVerbosity() > 1)
+		printf("Selected device %u:%u: %s\n", ranked[0].platformIndex, ranked[0].deviceIndex, ranked[0].info->name.c_str());
+	return true;
+}
+
+void oclPrintDeviceRanking(const std::vector<oclDeviceCandidate>& ranked)
+{
+	for(size_t i = 0; i < ranked.size(); i++)
+	{
+		const oclDeviceCandidate& c = ranked[i];
+		printf("%2u. [%u:%u] %-40s %8.1f GFLOP/s  score %8.1f\n",
+			(unsigned int)i + 1, c.platformIndex, c.deviceIndex, c.info->name.c_str(), c.throughput, c.score);
+	}
+}
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#ifdef _WIN32
+#  include "oclWindows.h"
+#  include <direct.h>
+#  include <process.h>
+#  include <sys/utime.h>
+#else
+#  include <limits.h>
+#  include <stdlib.h>
+#  include <dirent.h>
+#  include <errno.h>
+#  include <sys/stat.h>
+#  include <sys/time.h>
+#  include <unistd.h>
+#endif
+
+#include "oclFileUtil.h"
+
+cl_ulong oclHashBytes(const void* data, size_t size, cl_ulong seed)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	cl_ulong hash = seed;
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+cl_ulong oclHashString(const std::string& value, cl_ulong seed)
+{
+	// Include the length so that ("ab","c") and ("a","bc") hash differently.
+	const cl_ulong length = value.size();
+	seed = oclHashBytes(&length, sizeof(length), seed);
+	return oclHashBytes(value.data(), value.size(), seed);
+}
+
+bool oclStatFile(const std::string& path, oclFileStat* stat)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if( !GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data) )
+		return false;
+	if( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+		return false;
+	stat->size = ((cl_ulong)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	// FILETIME is in 100ns units
+	stat->mtime = (((cl_ulong)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime) * 100;
+#else
+	struct stat st;
+	if( ::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) )
+		return false;
+	stat->size = (cl_ulong)st.st_size;
+#if defined(__APPLE__)
+	stat->mtime = (cl_ulong)st.st_mtimespec.tv_sec * 1000000000ULL + st.st_mtimespec.tv_nsec;
+#else
+	stat->mtime = (cl_ulong)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+bool oclReadFile(const std::string& path, std::vector<unsigned char>* data)
+{
+	FILE* f = fopen(path.c_str(), "rb");
+	if(!f)
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if(length < 0)
+	{
+		fclose(f);
+		return false;
+	}
+
+	data->resize((size_t)length);
+	size_t read = length > 0 ? fread(&(*data)[0], 1, (size_t)length, f) : 0;
+	fclose(f);
+	return read == (size_t)length;
+}
+
+bool oclWriteFileAtomic(const std::string& path, const void* data, size_t size)
+{
+	static std::atomic<unsigned int> counter(0);
+	char suffix[64];
+#ifdef _WIN32
+	sprintf(suffix, ".tmp.%d.%u", _getpid(), counter++);
+#else
+	sprintf(suffix, ".tmp.%d.%u", (int)getpid(), counter++);
+#endif
+	const std::string tmpPath = path + suffix;
+
+	FILE* f = fopen(tmpPath.c_str(), "wb");
+	if(!f)
+		return false;
+	const bool written = fwrite(data, 1, size, f) == size;
+	const bool closed = fclose(f) == 0;
+	if(!written || !closed)
+	{
+		remove(tmpPath.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	if( !MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) )
+#else
+	if( rename(tmpPath.c_str(), path.c_str()) != 0 )
+#endif
+	{
+		remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool oclRemoveFile(const std::string& path)
+{
+	return remove(path.c_str()) == 0;
+}
+
+bool oclTouchFile(const std::string& path)
+{
+#ifdef _WIN32
+	return _utime(path.c_str(), NULL) == 0;
+#else
+	return utimes(path.c_str(), NULL) == 0;
+#endif
+}
+
+bool oclMakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	return _mkdir(path.c_str()) == 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool oclListDirectory(const std::string& directory, std::vector<std::string>* names)
+{
+	names->clear();
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(oclJoinPath(directory, "*").c_str(), &data);
+	if(find == INVALID_HANDLE_VALUE)
+		return false;
+	do
+	{
+		if( !(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) )
+			names->push_back(data.cFileName);
+	} while( FindNextFileA(find, &data) );
+	FindClose(find);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if(dir == NULL)
+		return false;
+	struct dirent* entry;
+	while( (entry = readdir(dir)) != NULL )
+	{
+		if( strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0 )
+			names->push_back(entry->d_name);
+	}
+	closedir(dir);
+#endif
+	return true;
+}
+
+std::string oclJoinPath(const std::string& directory, const std::string& name)
+{
+	if( directory.empty() )
+		return name;
+	const char last = directory[directory.size() - 1];
+	if( last == '/' || last == '\\' )
+		return directory + name;
+	return directory + "/" + name;
+}
+
+std::string oclDirectoryOf(const std::string& path)
+{
+	const size_t pos = path.find_last_of("/\\");
+	if(pos == std::string::npos)
+		return std::string();
+	return path.substr(0, pos + 1);
+}
+
+std::string oclCanonicalPath(const std::string& path)
+{
+#ifdef _WIN32
+	char resolved[MAX_PATH];
+	if( _fullpath(resolved, path.c_str(), MAX_PATH) == NULL )
+		return path;
+#else
+	char resolved[PATH_MAX];
+	if( realpath(path.c_str(), resolved) == NULL )
+		return path;
+#endif
+	return std::string(resolved);
+}
@@ -0,0 +1,39 @@
+#ifndef OCL_FILE_UTIL_H
+#define OCL_FILE_UTIL_H
+
+// Internal file system helpers shared by the program cache and source loaders.
+
+#include <string>
+#include <vector>
+#include <CL/cl.h>
+
+#define OCL_HASH_SEED 14695981039346656037ULL
+
+// 64 bit FNV-1a. Pass the previous result as seed to hash several pieces.
+cl_ulong oclHashBytes(const void* data, size_t size, cl_ulong seed = OCL_HASH_SEED);
+cl_ulong oclHashString(const std::string& value, cl_ulong seed = OCL_HASH_SEED);
+
+struct oclFileStat
+{
+	cl_ulong size;
+	// Modification time in nanoseconds since the epoch where available.
+	cl_ulong mtime;
+};
+
+bool oclStatFile(const std::string& path, oclFileStat* stat);
+bool oclReadFile(const std::string& path, std::vector<unsigned char>* data);
+// Writes to a temporary file in the same directory and renames it over path.
+bool oclWriteFileAtomic(const std::string& path, const void* data, size_t size);
+bool oclRemoveFile(const std::string& path);
+// Sets the modification time to now.
+bool oclTouchFile(const std::string& path);
+bool oclMakeDirectory(const std::string& path);
+// Lists regular file names (not paths) in directory.
+bool oclListDirectory(const std::string& directory, std::vector<std::string>* names);
+std::string oclJoinPath(const std::string& directory, const std::string& name);
+// Directory part of path including the trailing separator, or "" if none.
+std::string oclDirectoryOf(const std::string& path);
+// Absolute path with symlinks resolved. Returns path unchanged if it can't be resolved.
+std::string oclCanonicalPath(const std::string& path);
+
+#endif
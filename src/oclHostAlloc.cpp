@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#  include "oclWindows.h"
+#  include <malloc.h>
+#else
+#  include <unistd.h>
+#  include <sys/mman.h>
+#endif
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclHostAlloc.h>
+
+struct oclHostAllocation
+{
+	size_t size;
+	size_t alignment;
+	unsigned int flags;
+	// Allocated with VirtualAlloc(MEM_LARGE_PAGES) rather than the aligned heap.
+	bool largePages;
+};
+
+static std::mutex oclHostAllocMutex;
+static std::unordered_map<const void*, oclHostAllocation> oclHostAllocations;
+
+static std::atomic<unsigned long long> oclAlignmentChecks(0);
+static std::atomic<unsigned long long> oclMisalignedTransfers(0);
+static std::atomic<unsigned long long> oclMisalignedBytes(0);
+
+static size_t oclQueryPageSize()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	long size = sysconf(_SC_PAGESIZE);
+	return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+static size_t oclQueryHugePageSize()
+{
+	size_t size = 0;
+#ifdef _WIN32
+	size = GetLargePageMinimum();
+#elif defined(__linux__)
+	FILE* meminfo = fopen("/proc/meminfo", "r");
+	if(meminfo != NULL)
+	{
+		char line[128];
+		unsigned long kb;
+		while( fgets(line, sizeof(line), meminfo) != NULL )
+		{
+			if( sscanf(line, "Hugepagesize: %lu kB", &kb) == 1 )
+			{
+				size = (size_t)kb * 1024;
+				break;
+			}
+		}
+		fclose(meminfo);
+	}
+#endif
+	return size;
+}
+
+size_t oclPageSize()
+{
+	static const size_t pageSize = oclQueryPageSize();
+	return pageSize;
+}
+
+size_t oclHugePageSize()
+{
+	static const size_t hugePageSize = oclQueryHugePageSize();
+	return hugePageSize;
+}
+
+size_t oclHostAlignment(cl_device_id device)
+{
+	size_t alignment = oclPageSize();
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	// CL_DEVICE_MEM_BASE_ADDR_ALIGN is in bits.
+	if(info != NULL && info->memBaseAddrAlign / 8 > alignment)
+		alignment = info->memBaseAddrAlign / 8;
+	return alignment;
+}
+
+static void* oclAllocAligned(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* memory = NULL;
+	return posix_memalign(&memory, alignment, size) == 0 ? memory : NULL;
+#endif
+}
+
+static void oclFreeAligned(void* memory)
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+// Returns huge page backed memory or NULL, leaving the fallback to the caller.
+static void* oclAllocHugePages(size_t* size, size_t alignment, bool* largePages)
+{
+	const size_t hugePage = oclHugePageSize();
+	if(hugePage == 0 || *size < hugePage || alignment > hugePage)
+		return NULL;
+
+	const size_t rounded = (*size + hugePage - 1) / hugePage * hugePage;
+#ifdef _WIN32
+	// Needs SeLockMemoryPrivilege, which most accounts don't have.
+	void* memory = VirtualAlloc(NULL, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	*largePages = memory != NULL;
+#else
+	// Transparent huge pages: align to the huge page size and ask the kernel to back it.
+	void* memory = oclAllocAligned(rounded, hugePage);
+#ifdef MADV_HUGEPAGE
+	if(memory != NULL)
+		madvise(memory, rounded, MADV_HUGEPAGE);
+#endif
+	*largePages = false;
+#endif
+	if(memory != NULL)
+		*size = rounded;
+	return memory;
+}
+
+void* oclHostAlloc(size_t size, size_t alignment, unsigned int flags)
+{
+	if(size == 0)
+		return NULL;
+	if(alignment == 0)
+		alignment = oclPageSize();
+	if( (alignment & (alignment - 1)) != 0 || alignment < sizeof(void*) )
+		return NULL;
+
+	oclHostAllocation allocation;
+	allocation.size = (size + alignment - 1) / alignment * alignment;
+	allocation.alignment = alignment;
+	allocation.flags = flags;
+	allocation.largePages = false;
+
+	void* memory = NULL;
+	if(flags & OCL_UTIL_HOST_ALLOC_HUGE_PAGES)
+		memory = oclAllocHugePages(&allocation.size, alignment, &allocation.largePages);
+	if(memory == NULL)
+		memory = oclAllocAligned(allocation.size, alignment);
+	if(memory == NULL)
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(oclHostAllocMutex);
+	oclHostAllocations[memory] = allocation;
+	return memory;
+}
+
+void* oclHostAllocForDevice(cl_device_id device, size_t size, unsigned int flags)
+{
+	return oclHostAlloc(size, oclHostAlignment(device), flags);
+}
+
+void* oclHostRealloc(void* memory, size_t size)
+{
+	if(memory == NULL)
+		return oclHostAlloc(size);
+	if(size == 0)
+	{
+		oclHostFree(memory);
+		return NULL;
+	}
+
+	oclHostAllocation allocation;
+	{
+		std::lock_guard<std::mutex> lock(oclHostAllocMutex);
+		std::unordered_map<const void*, oclHostAllocation>::iterator it = oclHostAllocations.find(memory);
+		if( it == oclHostAllocations.end() )
+			return NULL;
+		allocation = it->second;
+	}
+	if(size <= allocation.size)
+		return memory;
+
+	void* resized = oclHostAlloc(size, allocation.alignment, allocation.flags);
+	if(resized == NULL)
+		return NULL;
+	memcpy(resized, memory, allocation.size < size ? allocation.size : size);
+	oclHostFree(memory);
+	return resized;
+}
+
+void oclHostFree(void* memory)
+{
+	if(memory == NULL)
+		return;
+
+	oclHostAllocation allocation;
+	{
+		std::lock_guard<std::mutex> lock(oclHostAllocMutex);
+		std::unordered_map<const void*, oclHostAllocation>::iterator it = oclHostAllocations.find(memory);
+		if( it == oclHostAllocations.end() )
+		{
+			if(oclGetVerbosity() > 0)
+				printf("oclHostFree called on memory not allocated by oclHostAlloc\n");
+			return;
+		}
+		allocation = it->second;
+		oclHostAllocations.erase(it);
+	}
+
+#ifdef _WIN32
+	if(allocation.largePages)
+	{
+		VirtualFree(memory, 0, MEM_RELEASE);
+		return;
+	}
+#endif
+	oclFreeAligned(memory);
+}
+
+size_t oclHostAllocSize(const void* memory)
+{
+	std::lock_guard<std::mutex> lock(oclHostAllocMutex);
+	std::unordered_map<const void*, oclHostAllocation>::const_iterator it = oclHostAllocations.find(memory);
+	return it == oclHostAllocations.end() ? 0 : it->second.size;
+}
+
+// Alignment the runtime needs to DMA from or use a host pointer in place.
+static size_t oclTransferAlignment(cl_device_id device)
+{
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	if(info == NULL || info->memBaseAddrAlign < 8)
+		return 1;
+	return info->memBaseAddrAlign / 8;
+}
+
+bool oclIsHostPtrAligned(const void* ptr, cl_device_id device)
+{
+	return ((size_t)ptr % oclTransferAlignment(device)) == 0;
+}
+
+// Transfers from one thread nearly always go to the same queue, so remember
+// the alignment of the last one instead of querying its device every time.
+// A released queue whose handle is reused can at worst skew the warnings.
+static size_t oclQueueTransferAlignment(cl_command_queue queue)
+{
+	static thread_local cl_command_queue lastQueue = NULL;
+	static thread_local size_t lastAlignment = 0;
+	if(queue == lastQueue)
+		return lastAlignment;
+
+	cl_device_id device = NULL;
+	if( clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL) != CL_SUCCESS )
+		return 0;
+	lastQueue = queue;
+	lastAlignment = oclTransferAlignment(device);
+	return lastAlignment;
+}
+
+bool oclCheckHostPtr(cl_command_queue queue, const void* ptr, size_t size, const char* action)
+{
+	if(ptr == NULL)
+		return true;
+	const size_t alignment = oclQueueTransferAlignment(queue);
+	if(alignment == 0)
+		return true;
+
+	oclAlignmentChecks++;
+	if( ((size_t)ptr % alignment) == 0 )
+		return true;
+
+	const unsigned long long count = ++oclMisalignedTransfers;
+	oclMisalignedBytes += size;
+	if( count <= OCL_UTIL_MISALIGNED_WARNINGS && oclGetVerbosity() >= 1 )
+	{
+		printf("%s: host pointer %p is not %u byte aligned, the runtime may copy %u bytes through a staging buffer."
+			" Allocate with oclHostAllocForDevice to avoid it.%s\n",
+			action, ptr, (unsigned int)alignment, (unsigned int)size,
+			count == OCL_UTIL_MISALIGNED_WARNINGS ? " (further warnings suppressed)" : "");
+	}
+	return false;
+}
+
+oclHostAlignmentStats oclGetHostAlignmentStats()
+{
+	oclHostAlignmentStats stats;
+	stats.checks = oclAlignmentChecks;
+	stats.misaligned = oclMisalignedTransfers;
+	stats.misalignedBytes = oclMisalignedBytes;
+	return stats;
+}
+
+void oclResetHostAlignmentStats()
+{
+	oclAlignmentChecks = 0;
+	oclMisalignedTransfers = 0;
+	oclMisalignedBytes = 0;
+}
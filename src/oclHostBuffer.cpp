@@ -0,0 +1,89 @@
+#include <stdio.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclHostAlloc.h>
+#include <oclHostBuffer.h>
+
+bool oclCreateHostBuffer(cl_context context, cl_device_id device, size_t size, cl_mem_flags flags, oclHostBuffer* buffer)
+{
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	if(info == NULL || size == 0)
+		return false;
+
+	flags &= ~(cl_mem_flags)(CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR);
+	*buffer = oclHostBuffer();
+	buffer->size = size;
+
+	cl_int error;
+	if( info->sharesHostMemory() )
+	{
+		// Page aligned and a whole number of pages, and at least as strict as
+		// CL_DEVICE_MEM_BASE_ADDR_ALIGN, so the runtime can use it in place.
+		buffer->host = oclHostAllocForDevice(device, size);
+		if(buffer->host != NULL)
+		{
+			buffer->buffer = clCreateBuffer(context, flags | CL_MEM_USE_HOST_PTR, size, buffer->host, &error);
+			if(error == CL_SUCCESS)
+			{
+				buffer->zeroCopy = true;
+				return true;
+			}
+			oclHostFree(buffer->host);
+			buffer->host = NULL;
+		}
+		// Fall through to an ordinary buffer.
+	}
+
+	buffer->buffer = clCreateBuffer(context, flags, size, NULL, &error);
+	if( !oclHandleErrorMessage("Creating host buffer", error) )
+	{
+		buffer->buffer = NULL;
+		return false;
+	}
+	return true;
+}
+
+void oclReleaseHostBuffer(oclHostBuffer* buffer)
+{
+	if(buffer->buffer != NULL)
+		clReleaseMemObject(buffer->buffer);
+	if(buffer->host != NULL)
+		oclHostFree(buffer->host);
+	*buffer = oclHostBuffer();
+}
+
+void* oclMapHostBuffer(cl_command_queue queue, const oclHostBuffer& buffer, cl_map_flags flags,
+	size_t offset, size_t size, cl_int* error)
+{
+	cl_int localError;
+	if(error == NULL)
+		error = &localError;
+
+	// Still mapped through the runtime on zero-copy buffers so that the
+	// device sees a consistent view, but no data moves.
+	void* mapped = clEnqueueMapBuffer(queue, buffer.buffer, CL_TRUE, flags, offset, size, 0, NULL, NULL, error);
+	if( !oclHandleErrorMessage("Mapping host buffer", *error) )
+		return NULL;
+	return mapped;
+}
+
+cl_int oclUnmapHostBuffer(cl_command_queue queue, const oclHostBuffer& buffer, void* mapped, cl_event* event)
+{
+	return clEnqueueUnmapMemObject(queue, buffer.buffer, mapped, 0, NULL, event);
+}
+
+cl_int oclWriteHostBuffer(cl_command_queue queue, const oclHostBuffer& buffer, size_t offset, size_t size,
+	const void* data, cl_bool blocking, cl_event* event)
+{
+	oclCheckHostPtr(queue, data, size, "Writing host buffer");
+	return clEnqueueWriteBuffer(queue, buffer.buffer, blocking, offset, size, data, 0, NULL, event);
+}
+
+cl_int oclReadHostBuffer(cl_command_queue queue, const oclHostBuffer& buffer, size_t offset, size_t size,
+	void* data, cl_bool blocking, cl_event* event)
+{
+	oclCheckHostPtr(queue, data, size, "Reading host buffer");
+	return clEnqueueReadBuffer(queue, buffer.buffer, blocking, offset, size, data, 0, NULL, event);
+}
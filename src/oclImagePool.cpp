@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclImagePool.h>
+
+struct oclImageFormatKey
+{
+	cl_context context;
+	cl_mem_flags flags;
+	cl_mem_object_type imageType;
+
+	bool operator<(const oclImageFormatKey& other) const
+	{
+		if(context != other.context)
+			return context < other.context;
+		if(flags != other.flags)
+			return flags < other.flags;
+		return imageType < other.imageType;
+	}
+};
+
+static std::mutex oclImageFormatsMutex;
+// Entries are only removed by oclReleaseImageFormats, so returned references stay valid until then.
+static std::map< oclImageFormatKey, std::vector<cl_image_format> > oclImageFormatTables;
+
+const std::vector<cl_image_format>& oclGetImageFormats(cl_context context, cl_mem_flags flags,
+	cl_mem_object_type imageType)
+{
+	oclImageFormatKey key;
+	key.context = context;
+	key.flags = flags;
+	key.imageType = imageType;
+
+	std::lock_guard<std::mutex> lock(oclImageFormatsMutex);
+	std::map< oclImageFormatKey, std::vector<cl_image_format> >::iterator it = oclImageFormatTables.find(key);
+	if( it != oclImageFormatTables.end() )
+		return it->second;
+
+	std::vector<cl_image_format>& formats = oclImageFormatTables[key];
+	cl_uint count = 0;
+	cl_int error = clGetSupportedImageFormats(context, flags, imageType, 0, NULL, &count);
+	if(error == CL_SUCCESS && count > 0)
+	{
+		formats.resize(count);
+		error = clGetSupportedImageFormats(context, flags, imageType, count, &formats[0], NULL);
+	}
+	if( !oclHandleErrorMessage("Querying supported image formats", error) )
+		formats.clear();
+	return formats;
+}
+
+bool oclIsImageFormatSupported(cl_context context, cl_mem_flags flags, cl_mem_object_type imageType,
+	const cl_image_format& format)
+{
+	const std::vector<cl_image_format>& formats = oclGetImageFormats(context, flags, imageType);
+	for(size_t i = 0; i < formats.size(); i++)
+	{
+		if( formats[i].image_channel_order == format.image_channel_order &&
+			formats[i].image_channel_data_type == format.image_channel_data_type )
+			return true;
+	}
+	return false;
+}
+
+void oclReleaseImageFormats(cl_context context)
+{
+	std::lock_guard<std::mutex> lock(oclImageFormatsMutex);
+	std::map< oclImageFormatKey, std::vector<cl_image_format> >::iterator it = oclImageFormatTables.begin();
+	while( it != oclImageFormatTables.end() )
+	{
+		if(it->first.context == context)
+			oclImageFormatTables.erase(it++);
+		else
+			++it;
+	}
+}
+
+size_t oclImageFormatSize(const cl_image_format& format)
+{
+	// Packed types describe the whole pixel.
+	switch(format.image_channel_data_type)
+	{
+	case CL_UNORM_SHORT_565:
+	case CL_UNORM_SHORT_555:
+		return 2;
+	case CL_UNORM_INT_101010:
+		return 4;
+	}
+
+	size_t channels;
+	switch(format.image_channel_order)
+	{
+	case CL_R: case CL_A: case CL_INTENSITY: case CL_LUMINANCE:
+		channels = 1; break;
+	case CL_RG: case CL_RA:
+		channels = 2; break;
+	case CL_RGB:
+		channels = 3; break;
+	case CL_RGBA: case CL_BGRA: case CL_ARGB:
+		channels = 4; break;
+	default:
+		return 0;
+	}
+
+	switch(format.image_channel_data_type)
+	{
+	case CL_SNORM_INT8: case CL_UNORM_INT8: case CL_SIGNED_INT8: case CL_UNSIGNED_INT8:
+		return channels;
+	case CL_SNORM_INT16: case CL_UNORM_INT16: case CL_SIGNED_INT16: case CL_UNSIGNED_INT16: case CL_HALF_FLOAT:
+		return channels * 2;
+	case CL_SIGNED_INT32: case CL_UNSIGNED_INT32: case CL_FLOAT:
+		return channels * 4;
+	}
+	return 0;
+}
+
+bool oclImagePool::Key::operator<(const Key& other) const
+{
+	if(flags != other.flags)
+		return flags < other.flags;
+	if(order != other.order)
+		return order < other.order;
+	if(type != other.type)
+		return type < other.type;
+	if(width != other.width)
+		return width < other.width;
+	if(height != other.height)
+		return height < other.height;
+	return depth < other.depth;
+}
+
+cl_ulong oclImagePool::Key::bytes() const
+{
+	cl_image_format format;
+	format.image_channel_order = order;
+	format.image_channel_data_type = type;
+	return (cl_ulong)oclImageFormatSize(format) * width * height * (depth > 0 ? depth : 1);
+}
+
+// True once event has completed or failed, so commands no longer use its image.
+static bool oclEventDone(cl_event event)
+{
+	if(event == NULL)
+		return true;
+	cl_int status = CL_COMPLETE;
+	if( clGetEventInfo(event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL) != CL_SUCCESS )
+		return true;
+	return status <= CL_COMPLETE;
+}
+
+oclImagePool::oclImagePool(cl_context context, cl_ulong highWaterBytes)
+	: m_context(ocl::Context::retain(context))
+	, m_highWaterBytes(highWaterBytes)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+oclImagePool::~oclImagePool()
+{
+	trim(0);
+}
+
+cl_mem oclImagePool::acquire(const cl_image_format& format, size_t width, size_t height, size_t depth,
+	cl_mem_flags flags, cl_int* error)
+{
+	cl_int localError;
+	if(error == NULL)
+		error = &localError;
+
+	if( flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR) )
+	{
+		*error = CL_INVALID_VALUE;
+		return NULL;
+	}
+
+	const cl_mem_object_type imageType = depth > 0 ? CL_MEM_OBJECT_IMAGE3D : CL_MEM_OBJECT_IMAGE2D;
+	if( !oclIsImageFormatSupported(m_context, flags, imageType, format) )
+	{
+		*error = CL_IMAGE_FORMAT_NOT_SUPPORTED;
+		oclHandleErrorMessage("Acquiring pooled image", *error);
+		return NULL;
+	}
+
+	Key key;
+	key.flags = flags;
+	key.order = format.image_channel_order;
+	key.type = format.image_channel_data_type;
+	key.width = width;
+	key.height = height;
+	key.depth = depth;
+	const cl_ulong bytes = key.bytes();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.acquires++;
+
+		std::map< Key, std::vector<LruList::iterator> >::iterator list = m_freeLists.find(key);
+		// Images that enqueued commands still use are skipped.
+		size_t i = list != m_freeLists.end() ? list->second.size() : 0;
+		while( i > 0 && !oclEventDone(list->second[i - 1]->inUseUntil) )
+			i--;
+		if(i > 0)
+		{
+			LruList::iterator cached = list->second[i - 1];
+			list->second.erase(list->second.begin() + (i - 1));
+			// The caller takes over the pool's reference.
+			cl_mem image = cached->image.detach();
+			m_lru.erase(cached);
+
+			m_stats.hits++;
+			m_stats.bytesCached -= bytes;
+			m_stats.bytesInUse += bytes;
+			m_inUse[image] = key;
+			*error = CL_SUCCESS;
+			return image;
+		}
+		m_stats.misses++;
+	}
+
+	cl_mem image;
+	for(int attempt = 0; attempt < 2; attempt++)
+	{
+		if(depth > 0)
+			image = clCreateImage3D(m_context, flags, &format, width, height, depth, 0, 0, NULL, error);
+		else
+			image = clCreateImage2D(m_context, flags, &format, width, height, 0, NULL, error);
+
+		if(*error != CL_MEM_OBJECT_ALLOCATION_FAILURE && *error != CL_OUT_OF_RESOURCES)
+			break;
+		// Give the cached images back to the driver and try once more.
+		trim(0);
+	}
+	if( !oclHandleErrorMessage("Creating pooled image", *error) )
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.bytesInUse += bytes;
+	m_inUse[image] = key;
+	return image;
+}
+
+void oclImagePool::release(cl_mem image, cl_event inUseUntil)
+{
+	if(image == NULL)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::unordered_map<cl_mem, Key>::iterator it = m_inUse.find(image);
+	if( it == m_inUse.end() )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Image returned to a pool it does not belong to, releasing it\n");
+		clReleaseMemObject(image);
+		return;
+	}
+
+	const Key key = it->second;
+	m_inUse.erase(it);
+	m_stats.bytesInUse -= key.bytes();
+
+	CachedImage cached;
+	cached.key = key;
+	cached.image.reset(image);
+	if(inUseUntil != NULL)
+		cached.inUseUntil = ocl::Event::retain(inUseUntil);
+	m_freeLists[key].push_back(m_lru.insert(m_lru.end(), std::move(cached)));
+	m_stats.bytesCached += key.bytes();
+
+	if(m_stats.bytesCached > m_highWaterBytes)
+		trimLocked(m_highWaterBytes);
+}
+
+void oclImagePool::trim(cl_ulong targetBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	trimLocked(targetBytes);
+}
+
+void oclImagePool::trimLocked(cl_ulong targetBytes)
+{
+	while( m_stats.bytesCached > targetBytes && !m_lru.empty() )
+	{
+		LruList::iterator oldest = m_lru.begin();
+		std::vector<LruList::iterator>& list = m_freeLists[oldest->key];
+		list.erase(std::find(list.begin(), list.end(), oldest));
+
+		m_stats.bytesCached -= oldest->key.bytes();
+		m_stats.trimmed++;
+		// Erasing the entry releases the image.
+		m_lru.erase(oldest);
+	}
+}
+
+void oclImagePool::setHighWaterBytes(cl_ulong highWaterBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_highWaterBytes = highWaterBytes;
+	trimLocked(m_highWaterBytes);
+}
+
+oclImagePoolStats oclImagePool::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+static std::mutex oclImagePoolsMutex;
+static std::map<cl_context, oclImagePool*> oclImagePools;
+
+oclImagePool* oclGetImagePool(cl_context context)
+{
+	std::lock_guard<std::mutex> lock(oclImagePoolsMutex);
+	oclImagePool*& pool = oclImagePools[context];
+	if(pool == NULL)
+		pool = new oclImagePool(context);
+	return pool;
+}
+
+void oclReleaseImagePool(cl_context context)
+{
+	oclImagePool* pool = NULL;
+	{
+		std::lock_guard<std::mutex> lock(oclImagePoolsMutex);
+		std::map<cl_context, oclImagePool*>::iterator it = oclImagePools.find(context);
+		if( it != oclImagePools.end() )
+		{
+			pool = it->second;
+			oclImagePools.erase(it);
+		}
+	}
+	delete pool;
+	oclReleaseImageFormats(context);
+}
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclProgramCache.h>
+#include <oclKernelVariants.h>
+
+oclSpecialization& oclSpecialization::define(const std::string& name, const std::string& value)
+{
+	m_defines.push_back(std::make_pair(name, value));
+	m_key += name + "=" + value + ";";
+	return *this;
+}
+
+oclSpecialization& oclSpecialization::define(const std::string& name, long long value)
+{
+	std::ostringstream stream;
+	stream << value;
+	return define(name, stream.str());
+}
+
+std::string oclSpecialization::buildOptions(const char* baseOptions) const
+{
+	std::string options(baseOptions ? baseOptions : "");
+	for(size_t i = 0; i < m_defines.size(); i++)
+	{
+		if( !options.empty() )
+			options += " ";
+		options += "-D " + m_defines[i].first + "=" + m_defines[i].second;
+	}
+	return options;
+}
+
+std::string oclSpecialization::defineBlock() const
+{
+	std::string block;
+	for(size_t i = 0; i < m_defines.size(); i++)
+		block += "#define " + m_defines[i].first + " " + m_defines[i].second + "\n";
+	return block;
+}
+
+oclKernelVariants::oclKernelVariants(cl_context context, cl_device_id device, const char* filename, const char* kernelName,
+	const std::vector<std::string>& parameterNames, const char* baseOptions, oclVariantMode mode)
+	: m_context(context)
+	, m_device(device)
+	, m_kernelName(kernelName)
+	, m_parameterNames(parameterNames)
+	, m_baseOptions(baseOptions ? baseOptions : "")
+	, m_mode(mode)
+	, m_sourceLoaded(false)
+{
+	clRetainContext(m_context);
+
+	int length = 0;
+	char* source = oclLoadProgramContents(filename, &length);
+	if(source != NULL)
+	{
+		m_source.assign(source, length);
+		m_sourceLoaded = true;
+		free(source);
+	}
+}
+
+oclKernelVariants::~oclKernelVariants()
+{
+	for(std::map<std::string, Variant>::iterator it = m_variants.begin(); it != m_variants.end(); ++it)
+	{
+		if(it->second.building || it->second.error != CL_SUCCESS)
+			continue;
+		clReleaseKernel(it->second.kernel);
+		clReleaseProgram(it->second.program);
+	}
+	clReleaseContext(m_context);
+}
+
+cl_int oclKernelVariants::build(const oclSpecialization& spec, Variant* variant)
+{
+	std::string source, options;
+	if(m_mode == OCL_VARIANT_PREPENDED_DEFINES)
+	{
+		source = spec.defineBlock() + "#line 1\n" + m_source;
+		options = m_baseOptions;
+	}
+	else
+	{
+		source = m_source;
+		options = spec.buildOptions(m_baseOptions.c_str());
+	}
+
+	cl_int error;
+	variant->program = oclBuildProgramCached(m_context, m_device, source.data(), source.size(), options.c_str(), &error);
+	if(error != CL_SUCCESS)
+	{
+		if(oclGetVerbosity() > 0)
+		{
+			printf("Failed to build %s with %s\n", m_kernelName.c_str(), spec.key().c_str());
+			oclPrintBuildLog(variant->program, m_device);
+		}
+		if(variant->program)
+			clReleaseProgram(variant->program);
+		return error;
+	}
+
+	variant->kernel = clCreateKernel(variant->program, m_kernelName.c_str(), &error);
+	if( !oclHandleErrorMessage("Creating kernel variant", error) )
+	{
+		clReleaseProgram(variant->program);
+		return error;
+	}
+	return CL_SUCCESS;
+}
+
+cl_kernel oclKernelVariants::get(const oclSpecialization& spec, cl_int* error)
+{
+	cl_int localError;
+	if(error == NULL)
+		error = &localError;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for(;;)
+	{
+		std::map<std::string, Variant>::iterator it = m_variants.find(spec.key());
+		if( it == m_variants.end() )
+			break;
+		if( !it->second.building )
+		{
+			*error = it->second.error;
+			return it->second.kernel;
+		}
+		// Waiters retry from scratch if the build threw and the marker was removed.
+		m_built.wait(lock);
+	}
+
+	if(!m_sourceLoaded)
+	{
+		*error = CL_INVALID_PROGRAM;
+		return NULL;
+	}
+
+	Variant marker = Variant();
+	marker.building = true;
+	m_variants[spec.key()] = marker;
+	lock.unlock();
+
+	Variant variant = Variant();
+	try
+	{
+		*error = build(spec, &variant);
+	}
+	catch(...)
+	{
+		// Don't leave waiters blocked on a marker nobody will complete.
+		lock.lock();
+		m_variants.erase(spec.key());
+		m_built.notify_all();
+		throw;
+	}
+
+	// Failures are kept too, so a bad spec fails fast instead of rebuilding.
+	if(*error != CL_SUCCESS)
+		variant = Variant();
+	variant.error = *error;
+
+	lock.lock();
+	m_variants[spec.key()] = variant;
+	m_built.notify_all();
+	return variant.kernel;
+}
+
+size_t oclKernelVariants::variantCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t count = 0;
+	for(std::map<std::string, Variant>::const_iterator it = m_variants.begin(); it != m_variants.end(); ++it)
+	{
+		if( !it->second.building && it->second.error == CL_SUCCESS )
+			count++;
+	}
+	return count;
+}
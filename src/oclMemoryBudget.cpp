@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <chrono>
+#include <map>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclHostAlloc.h>
+#include <oclMemoryBudget.h>
+
+oclMemoryBudget::oclMemoryBudget(cl_ulong limitBytes)
+	: m_limit(limitBytes)
+	, m_live(0)
+	, m_peak(0)
+	, m_failures(0)
+{
+}
+
+bool oclMemoryBudget::tryReserve(cl_ulong bytes)
+{
+	return reserve(bytes, 0);
+}
+
+bool oclMemoryBudget::reserve(cl_ulong bytes, long timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if(bytes > m_limit)
+	{
+		m_failures++;
+		return false;
+	}
+
+	const auto fits = [this, bytes]() { return m_live + bytes <= m_limit; };
+	if(timeoutMs < 0)
+		m_released.wait(lock, fits);
+	else if( !m_released.wait_for(lock, std::chrono::milliseconds(timeoutMs), fits) )
+	{
+		m_failures++;
+		return false;
+	}
+
+	m_live += bytes;
+	if(m_live > m_peak)
+		m_peak = m_live;
+	return true;
+}
+
+void oclMemoryBudget::release(cl_ulong bytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_live = bytes < m_live ? m_live - bytes : 0;
+	}
+	m_released.notify_all();
+}
+
+void oclMemoryBudget::setLimit(cl_ulong limitBytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_limit = limitBytes;
+	}
+	m_released.notify_all();
+}
+
+cl_ulong oclMemoryBudget::limit() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_limit;
+}
+
+cl_ulong oclMemoryBudget::liveBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_live;
+}
+
+cl_ulong oclMemoryBudget::peakBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_peak;
+}
+
+cl_ulong oclMemoryBudget::available() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_live < m_limit ? m_limit - m_live : 0;
+}
+
+cl_ulong oclMemoryBudget::failures() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_failures;
+}
+
+struct oclBudgetedAllocation
+{
+	oclMemoryBudget* budget;
+	cl_ulong size;
+};
+
+static std::mutex oclBudgetMutex;
+// Budgets are never removed, so returned pointers stay valid.
+static std::map<cl_device_id, oclMemoryBudget*> oclBudgets;
+static std::map<cl_mem, oclBudgetedAllocation> oclBudgetedBuffers;
+
+oclMemoryBudget* oclGetMemoryBudget(cl_device_id device)
+{
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	if(info == NULL)
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(oclBudgetMutex);
+	oclMemoryBudget*& budget = oclBudgets[device];
+	if(budget == NULL)
+		budget = new oclMemoryBudget(info->globalMemSize / 100 * OCL_UTIL_BUDGET_PERCENT);
+	return budget;
+}
+
+// Creates a buffer whose bytes the caller already reserved from budget and records it.
+static cl_mem oclCreateReservedBuffer(cl_context context, oclMemoryBudget* budget, cl_mem_flags flags,
+	size_t size, void* hostPtr, cl_int* error)
+{
+	cl_mem buffer = clCreateBuffer(context, flags, size, hostPtr, error);
+	if(*error != CL_SUCCESS)
+		return NULL;
+
+	oclBudgetedAllocation allocation;
+	allocation.budget = budget;
+	allocation.size = size;
+	std::lock_guard<std::mutex> lock(oclBudgetMutex);
+	oclBudgetedBuffers[buffer] = allocation;
+	return buffer;
+}
+
+static bool oclReserveBudget(oclMemoryBudget* budget, cl_ulong size, long timeoutMs)
+{
+	if( budget->reserve(size, timeoutMs) )
+		return true;
+
+	if(oclGetVerbosity() > 0)
+		printf("Device memory budget exhausted: %u MByte requested, %u of %u MByte available\n",
+			(unsigned int)(size >> 20), (unsigned int)(budget->available() >> 20), (unsigned int)(budget->limit() >> 20));
+	return false;
+}
+
+cl_mem oclCreateBudgetedBuffer(cl_context context, cl_device_id device, cl_mem_flags flags, size_t size,
+	void* hostPtr, cl_int* error, long timeoutMs)
+{
+	cl_int status = CL_SUCCESS;
+	cl_mem buffer = NULL;
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	oclMemoryBudget* budget = oclGetMemoryBudget(device);
+
+	if(info == NULL || budget == NULL)
+		status = CL_INVALID_DEVICE;
+	else if(size == 0 || (info->maxMemAllocSize > 0 && size > info->maxMemAllocSize))
+		status = CL_INVALID_BUFFER_SIZE;
+	else if( !oclReserveBudget(budget, size, timeoutMs) )
+		status = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+	else
+	{
+		buffer = oclCreateReservedBuffer(context, budget, flags, size, hostPtr, &status);
+		if(buffer == NULL)
+			budget->release(size);
+	}
+
+	oclHandleErrorMessage("Creating budgeted buffer", status);
+	if(error != NULL)
+		*error = status;
+	return buffer;
+}
+
+void oclReleaseBudgetedBuffer(cl_mem buffer)
+{
+	if(buffer == NULL)
+		return;
+
+	oclBudgetedAllocation allocation = { NULL, 0 };
+	{
+		std::lock_guard<std::mutex> lock(oclBudgetMutex);
+		std::map<cl_mem, oclBudgetedAllocation>::iterator it = oclBudgetedBuffers.find(buffer);
+		if( it != oclBudgetedBuffers.end() )
+		{
+			allocation = it->second;
+			oclBudgetedBuffers.erase(it);
+		}
+	}
+
+	clReleaseMemObject(buffer);
+	if(allocation.budget != NULL)
+		allocation.budget->release(allocation.size);
+}
+
+bool oclCreateChunkedBuffer(cl_context context, cl_device_id device, cl_mem_flags flags, size_t size,
+	oclChunkedBuffer* buffer, size_t elementSize, size_t maxChunkSize, long timeoutMs)
+{
+	oclReleaseChunkedBuffer(buffer);
+
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	oclMemoryBudget* budget = oclGetMemoryBudget(device);
+	if(info == NULL || budget == NULL || size == 0 || elementSize == 0)
+		return false;
+	if( flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR) )
+		return false;
+
+	if(maxChunkSize == 0 || (info->maxMemAllocSize > 0 && maxChunkSize > info->maxMemAllocSize))
+		maxChunkSize = info->maxMemAllocSize > 0 ? (size_t)info->maxMemAllocSize : size;
+	const size_t chunkSize = maxChunkSize / elementSize * elementSize;
+	if(chunkSize == 0)
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Element of %u bytes exceeds the maximum chunk size\n", (unsigned int)elementSize);
+		return false;
+	}
+
+	// Reserve everything up front so a dataset that can't fit fails before any chunk is created.
+	if( !oclReserveBudget(budget, size, timeoutMs) )
+		return false;
+
+	for(size_t offset = 0; offset < size; offset += chunkSize)
+	{
+		const size_t bytes = size - offset < chunkSize ? size - offset : chunkSize;
+		cl_int error;
+		cl_mem chunk = oclCreateReservedBuffer(context, budget, flags, bytes, NULL, &error);
+		if( !oclHandleErrorMessage("Creating buffer chunk", error) )
+		{
+			// Chunks created so far give their bytes back on release, the rest here.
+			budget->release(size - offset);
+			oclReleaseChunkedBuffer(buffer);
+			return false;
+		}
+		buffer->chunks.push_back(chunk);
+	}
+
+	buffer->size = size;
+	buffer->chunkSize = chunkSize;
+	if( buffer->isSplit() && oclGetVerbosity() > 0 )
+		printf("Buffer of %u MByte split into %u chunks\n", (unsigned int)(size >> 20), buffer->chunkCount());
+	return true;
+}
+
+void oclReleaseChunkedBuffer(oclChunkedBuffer* buffer)
+{
+	for(size_t i = 0; i < buffer->chunks.size(); i++)
+		oclReleaseBudgetedBuffer(buffer->chunks[i]);
+	buffer->chunks.clear();
+	buffer->size = 0;
+	buffer->chunkSize = 0;
+}
+
+cl_int oclForEachChunk(const oclChunkedBuffer& buffer, size_t offset, size_t size,
+	const oclChunkFunction& function)
+{
+	if(offset + size > buffer.size || offset + size < offset)
+		return CL_INVALID_VALUE;
+
+	while(size > 0)
+	{
+		oclChunk chunk;
+		chunk.index = (cl_uint)(offset / buffer.chunkSize);
+		chunk.buffer = buffer.chunks[chunk.index];
+		chunk.offset = offset;
+		chunk.bufferOffset = offset - (size_t)chunk.index * buffer.chunkSize;
+		chunk.size = buffer.chunkSize - chunk.bufferOffset;
+		if(chunk.size > size)
+			chunk.size = size;
+
+		cl_int error = function(chunk);
+		if(error != CL_SUCCESS)
+			return error;
+
+		offset += chunk.size;
+		size -= chunk.size;
+	}
+	return CL_SUCCESS;
+}
+
+cl_int oclWriteChunkedBuffer(cl_command_queue queue, const oclChunkedBuffer& buffer, size_t offset, size_t size,
+	const void* data, cl_bool blocking)
+{
+	const char* bytes = (const char*)data;
+	oclCheckHostPtr(queue, data, size, "Writing chunked buffer");
+	return oclForEachChunk(buffer, offset, size, [&](const oclChunk& chunk)
+	{
+		return clEnqueueWriteBuffer(queue, chunk.buffer, blocking, chunk.bufferOffset, chunk.size,
+			bytes + (chunk.offset - offset), 0, NULL, NULL);
+	});
+}
+
+cl_int oclReadChunkedBuffer(cl_command_queue queue, const oclChunkedBuffer& buffer, size_t offset, size_t size,
+	void* data, cl_bool blocking)
+{
+	char* bytes = (char*)data;
+	oclCheckHostPtr(queue, data, size, "Reading chunked buffer");
+	return oclForEachChunk(buffer, offset, size, [&](const oclChunk& chunk)
+	{
+		return clEnqueueReadBuffer(queue, chunk.buffer, blocking, chunk.bufferOffset, chunk.size,
+			bytes + (chunk.offset - offset), 0, NULL, NULL);
+	});
+}
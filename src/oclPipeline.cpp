@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <utility>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclMemoryBudget.h>
+#include <oclPipeline.h>
+
+oclPipeline::oclPipeline()
+	: m_device(NULL)
+	, m_submitted(0)
+	, m_stopping(false)
+	, m_error(CL_SUCCESS)
+	, m_waitError(CL_SUCCESS)
+{
+}
+
+oclPipeline::~oclPipeline()
+{
+	destroy();
+}
+
+bool oclPipeline::create(cl_context context, cl_device_id device, const oclPipelineOptions& options)
+{
+	destroy();
+
+	if(context == NULL || oclGetDeviceInfo(device) == NULL || options.slots < 1 || options.maxInputBytes == 0)
+		return false;
+
+	m_context = ocl::Context::retain(context);
+	m_device = device;
+
+	cl_int error;
+	ocl::Queue* queues[2] = { &m_uploadQueue, &m_downloadQueue };
+	for(int i = 0; i < 2; i++)
+	{
+		queues[i]->reset(clCreateCommandQueue(context, device, 0, &error));
+		if( !oclHandleErrorMessage("Creating pipeline queue", error) )
+		{
+			destroy();
+			return false;
+		}
+	}
+
+	// In-place kernels download from the input buffer.
+	const size_t inputBytes = options.maxInputBytes;
+	const size_t outputBytes = options.maxOutputBytes ? options.maxOutputBytes : options.maxInputBytes;
+
+	m_slots.resize(options.slots);
+	for(cl_uint i = 0; i < options.slots; i++)
+	{
+		Slot& slot = m_slots[i];
+		slot.public_.index = i;
+		slot.public_.inputBytes = inputBytes;
+		slot.public_.outputBytes = outputBytes;
+
+		slot.public_.input = oclCreateBudgetedBuffer(m_context, m_device, CL_MEM_READ_WRITE, inputBytes, NULL, &error);
+		if(error == CL_SUCCESS && options.maxOutputBytes > 0)
+			slot.public_.output = oclCreateBudgetedBuffer(m_context, m_device, CL_MEM_READ_WRITE, outputBytes, NULL, &error);
+		else
+			slot.public_.output = slot.public_.input;
+		if(error != CL_SUCCESS)
+		{
+			destroy();
+			return false;
+		}
+
+		// Pinned staging, mapped once for the lifetime of the pipeline.
+		slot.pinnedInput.reset(clCreateBuffer(m_context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, inputBytes, NULL, &error));
+		if( oclHandleErrorMessage("Creating pinned pipeline input", error) )
+			slot.public_.hostInput = clEnqueueMapBuffer(m_uploadQueue, slot.pinnedInput, CL_TRUE, CL_MAP_WRITE, 0, inputBytes,
+				0, NULL, NULL, &error);
+		if( !oclHandleErrorMessage("Mapping pinned pipeline input", error) )
+		{
+			destroy();
+			return false;
+		}
+
+		slot.pinnedOutput.reset(clCreateBuffer(m_context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, outputBytes, NULL, &error));
+		if( oclHandleErrorMessage("Creating pinned pipeline output", error) )
+			slot.public_.hostOutput = clEnqueueMapBuffer(m_downloadQueue, slot.pinnedOutput, CL_TRUE, CL_MAP_READ, 0, outputBytes,
+				0, NULL, NULL, &error);
+		if( !oclHandleErrorMessage("Mapping pinned pipeline output", error) )
+		{
+			destroy();
+			return false;
+		}
+	}
+
+	m_stopping = false;
+	m_error = CL_SUCCESS;
+	m_waitError = CL_SUCCESS;
+	m_exception = std::exception_ptr();
+	m_consumerThread = std::thread(&oclPipeline::consumerLoop, this);
+	return true;
+}
+
+bool oclPipeline::create(const oclContext& context, cl_uint deviceIndex, const oclPipelineOptions& options)
+{
+	if(deviceIndex >= context.deviceCount())
+		return false;
+	return create(context.context, context.devices[deviceIndex], options);
+}
+
+void oclPipeline::destroy()
+{
+	if( m_consumerThread.joinable() )
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			drainLocked(lock);
+			m_stopping = true;
+		}
+		m_work.notify_all();
+		m_consumerThread.join();
+	}
+
+	for(size_t i = 0; i < m_stages.size(); i++)
+		clFinish(m_stages[i].queue);
+	m_stages.clear();
+
+	for(size_t i = 0; i < m_slots.size(); i++)
+	{
+		Slot& slot = m_slots[i];
+		if(slot.public_.hostInput != NULL)
+			clEnqueueUnmapMemObject(m_uploadQueue, slot.pinnedInput, slot.public_.hostInput, 0, NULL, NULL);
+		if(slot.public_.hostOutput != NULL)
+			clEnqueueUnmapMemObject(m_downloadQueue, slot.pinnedOutput, (void*)slot.public_.hostOutput, 0, NULL, NULL);
+		if(slot.public_.output != slot.public_.input)
+			oclReleaseBudgetedBuffer(slot.public_.output);
+		oclReleaseBudgetedBuffer(slot.public_.input);
+	}
+
+	// The unmaps have to complete before the pinned buffers go.
+	if(m_uploadQueue)
+		clFinish(m_uploadQueue);
+	if(m_downloadQueue)
+		clFinish(m_downloadQueue);
+	m_slots.clear();
+
+	m_uploadQueue.reset();
+	m_downloadQueue.reset();
+	m_context.reset();
+	m_device = NULL;
+	m_inFlight.clear();
+	m_submitted = 0;
+}
+
+bool oclPipeline::addKernelStage(cl_kernel kernel, cl_uint workDim, const size_t* globalWorkSize,
+	const size_t* localWorkSize, const oclPipelineArgs& setArgs)
+{
+	if(!m_context || workDim < 1 || workDim > 3 || m_submitted > 0)
+		return false;
+
+	Stage stage = Stage();
+	cl_int error;
+	stage.queue.reset(clCreateCommandQueue(m_context, m_device, 0, &error));
+	if( !oclHandleErrorMessage("Creating pipeline stage queue", error) )
+		return false;
+
+	stage.kernel = kernel;
+	stage.workDim = workDim;
+	stage.hasLocalWorkSize = localWorkSize != NULL;
+	for(cl_uint d = 0; d < workDim; d++)
+	{
+		stage.globalWorkSize[d] = globalWorkSize[d];
+		stage.localWorkSize[d] = localWorkSize ? localWorkSize[d] : 0;
+	}
+	stage.setArgs = setArgs;
+	m_stages.push_back(std::move(stage));
+	return true;
+}
+
+void oclPipeline::setConsumer(const oclPipelineConsumer& consumer)
+{
+	// Read by the consumer thread without locking, so only while nothing is in flight.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	drainLocked(lock);
+	m_consumer = consumer;
+}
+
+oclPipelineSlot* oclPipeline::acquire()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for(;;)
+	{
+		if( m_slots.empty() )
+			return NULL;
+		for(size_t i = 0; i < m_slots.size(); i++)
+		{
+			if( !m_slots[i].busy )
+			{
+				m_slots[i].busy = true;
+				return &m_slots[i].public_;
+			}
+		}
+		// Every slot is in flight or waiting for the consumer.
+		m_slotFree.wait(lock);
+	}
+}
+
+void oclPipeline::fail(cl_int error)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_error == CL_SUCCESS)
+		m_error = error;
+}
+
+cl_int oclPipeline::submit(oclPipelineSlot* publicSlot, size_t inputBytes, size_t outputBytes)
+{
+	if(publicSlot == NULL || publicSlot->index >= m_slots.size())
+		return CL_INVALID_VALUE;
+	Slot* slot = &m_slots[publicSlot->index];
+	if(outputBytes == 0)
+		outputBytes = slot->public_.outputBytes;
+	if(inputBytes > slot->public_.inputBytes || outputBytes > slot->public_.outputBytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		slot->busy = false;
+		m_slotFree.notify_one();
+		return CL_INVALID_BUFFER_SIZE;
+	}
+	slot->public_.item = m_submitted;
+
+	// Each stage waits for the previous stage of the same item only; the
+	// in-order stage queues keep consecutive items ordered.
+	cl_event previous = NULL;
+	cl_int error = CL_SUCCESS;
+	if(inputBytes > 0)
+	{
+		error = clEnqueueWriteBuffer(m_uploadQueue, slot->public_.input, CL_FALSE, 0, inputBytes,
+			slot->public_.hostInput, 0, NULL, &previous);
+		if(error == CL_SUCCESS)
+			clFlush(m_uploadQueue);
+	}
+
+	for(size_t i = 0; i < m_stages.size() && error == CL_SUCCESS; i++)
+	{
+		Stage& stage = m_stages[i];
+		if(stage.setArgs)
+			error = stage.setArgs(stage.kernel, slot->public_);
+		cl_event done = NULL;
+		if(error == CL_SUCCESS)
+			error = clEnqueueNDRangeKernel(stage.queue, stage.kernel, stage.workDim, NULL, stage.globalWorkSize,
+				stage.hasLocalWorkSize ? stage.localWorkSize : NULL, previous ? 1 : 0, previous ? &previous : NULL, &done);
+		if(previous != NULL)
+			clReleaseEvent(previous);
+		previous = done;
+		if(error == CL_SUCCESS)
+			clFlush(stage.queue);
+	}
+
+	if(error == CL_SUCCESS)
+	{
+		error = clEnqueueReadBuffer(m_downloadQueue, slot->public_.output, CL_FALSE, 0, outputBytes,
+			(void*)slot->public_.hostOutput, previous ? 1 : 0, previous ? &previous : NULL, slot->downloaded.out());
+		if(error == CL_SUCCESS)
+			clFlush(m_downloadQueue);
+	}
+	if(previous != NULL)
+		clReleaseEvent(previous);
+
+	if( !oclHandleErrorMessage("Submitting pipeline item", error) )
+	{
+		// Stages already enqueued may still use the slot's buffers.
+		clFinish(m_uploadQueue);
+		for(size_t i = 0; i < m_stages.size(); i++)
+			clFinish(m_stages[i].queue);
+		slot->downloaded.reset();
+		fail(error);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		slot->busy = false;
+		m_slotFree.notify_one();
+		return error;
+	}
+
+	m_submitted++;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_inFlight.push_back(slot);
+	}
+	m_work.notify_one();
+	return CL_SUCCESS;
+}
+
+void oclPipeline::consumerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for(;;)
+	{
+		m_work.wait(lock, [this] { return m_stopping || !m_inFlight.empty(); });
+		if( m_inFlight.empty() )
+			return;
+
+		// Stays at the front while consumed so finish() waits for it.
+		Slot* slot = m_inFlight.front();
+		lock.unlock();
+
+		cl_event downloaded = slot->downloaded;
+		cl_int error = clWaitForEvents(1, &downloaded);
+		slot->downloaded.reset();
+		// Nothing may escape this thread; finish() reports on the caller's.
+		std::exception_ptr exception;
+		if(error == CL_SUCCESS && m_consumer)
+		{
+			try
+			{
+				m_consumer(slot->public_);
+			}
+			catch(...)
+			{
+				exception = std::current_exception();
+			}
+		}
+
+		lock.lock();
+		if(error != CL_SUCCESS && m_waitError == CL_SUCCESS)
+			m_waitError = error;
+		if(error != CL_SUCCESS && m_error == CL_SUCCESS)
+			m_error = error;
+		if(exception && !m_exception)
+			m_exception = exception;
+		m_inFlight.pop_front();
+		slot->busy = false;
+		m_slotFree.notify_all();
+	}
+}
+
+void oclPipeline::drainLocked(std::unique_lock<std::mutex>& lock)
+{
+	m_slotFree.wait(lock, [this] { return m_inFlight.empty(); });
+}
+
+cl_int oclPipeline::finish()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	drainLocked(lock);
+	const cl_int error = m_error;
+	const cl_int waitError = m_waitError;
+	std::exception_ptr exception = m_exception;
+	m_error = CL_SUCCESS;
+	m_waitError = CL_SUCCESS;
+	m_exception = std::exception_ptr();
+	lock.unlock();
+
+	if(exception)
+		std::rethrow_exception(exception);
+	if(waitError != CL_SUCCESS)
+		oclHandleErrorMessage("Waiting for pipeline item", waitError);
+	return error;
+}
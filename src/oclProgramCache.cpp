@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclProgramCache.h>
+#include <oclRegistry.h>
+#include "oclFileUtil.h"
+
+static const char oclCacheMagic[4] = { 'O', 'C', 'L', 'B' };
+static const cl_uint oclCacheFormatVersion = 1;
+static const char* oclCacheExtension = ".clbin";
+
+struct oclCacheHeader
+{
+	char magic[4];
+	cl_uint formatVersion;
+	cl_uint keyLength;
+	cl_uint reserved;
+	cl_ulong binarySize;
+};
+
+static bool oclHasSuffix(const std::string& value, const char* suffix)
+{
+	const size_t length = strlen(suffix);
+	return value.size() >= length && value.compare(value.size() - length, length, suffix) == 0;
+}
+
+oclProgramCache::oclProgramCache(const char* directory, cl_ulong maxBytes)
+	: m_directory(directory)
+	, m_maxBytes(maxBytes)
+	, m_hits(0)
+	, m_misses(0)
+	, m_stores(0)
+	, m_evictions(0)
+	, m_loadFailures(0)
+{
+	oclMakeDirectory(m_directory);
+}
+
+std::string oclProgramCache::entryKey(cl_device_id device, const char* source, size_t length, const char* options, cl_ulong* hash) const
+{
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	char sourceHash[64];
+	sprintf(sourceHash, "%016llx:%llu", (unsigned long long)oclHashBytes(source, length), (unsigned long long)length);
+
+	// The full key is stored in the entry and compared on load, so a file name
+	// collision can never hand back the wrong binary.
+	std::string key;
+	key += "source=";
+	key += sourceHash;
+	key += "\noptions=";
+	key += options ? options : "";
+	if(info != NULL)
+	{
+		key += "\ndevice=" + info->name + " (" + info->vendor + ", " + info->deviceVersion + ")";
+		key += "\ndriver=" + info->driverVersion;
+		const oclPlatformEntry* platform = oclGetRegistry()->findPlatform(info->platform);
+		if(platform != NULL)
+			key += "\nplatform=" + platform->name + " " + platform->version;
+	}
+
+	*hash = oclHashString(key);
+	return key;
+}
+
+cl_program oclProgramCache::build(cl_context context, cl_device_id device, const char* source, size_t length,
+	const char* options, cl_int* error)
+{
+	cl_int localError;
+	if(error == NULL)
+		error = &localError;
+
+	cl_ulong hash;
+	const std::string key = entryKey(device, source, length, options, &hash);
+	char fileName[64];
+	sprintf(fileName, "%016llx%s", (unsigned long long)hash, oclCacheExtension);
+	const std::string path = oclJoinPath(m_directory, fileName);
+
+	cl_program program = loadBinary(context, device, path, key, options);
+	if(program != NULL)
+	{
+		m_hits++;
+		oclTouchFile(path);
+		*error = CL_SUCCESS;
+		return program;
+	}
+
+	m_misses++;
+	program = clCreateProgramWithSource(context, 1, &source, &length, error);
+	if( !oclHandleErrorMessage("Creating program from source", *error) )
+		return NULL;
+
+	*error = clBuildProgram(program, 1, &device, options, NULL, NULL);
+	if( !oclHandleErrorMessage("Building program", *error) )
+		return program;
+
+	storeBinary(program, device, path, key);
+	return program;
+}
+
+cl_program oclProgramCache::loadBinary(cl_context context, cl_device_id device, const std::string& path,
+	const std::string& key, const char* options)
+{
+	std::vector<unsigned char> data;
+	if( !oclReadFile(path, &data) )
+		return NULL;
+
+	oclCacheHeader header;
+	bool valid = data.size() >= sizeof(header);
+	if(valid)
+	{
+		memcpy(&header, &data[0], sizeof(header));
+		valid = memcmp(header.magic, oclCacheMagic, sizeof(header.magic)) == 0 &&
+			header.formatVersion == oclCacheFormatVersion &&
+			header.keyLength == key.size() &&
+			header.binarySize > 0 &&
+			data.size() == sizeof(header) + header.keyLength + header.binarySize &&
+			memcmp(&data[sizeof(header)], key.data(), key.size()) == 0;
+	}
+	if(!valid)
+	{
+		m_loadFailures++;
+		oclRemoveFile(path);
+		return NULL;
+	}
+
+	const unsigned char* binary = &data[sizeof(header) + header.keyLength];
+	size_t binarySize = (size_t)header.binarySize;
+	cl_int binaryStatus;
+	cl_int error;
+	cl_program program = clCreateProgramWithBinary(context, 1, &device, &binarySize, &binary, &binaryStatus, &error);
+	if(error == CL_SUCCESS && binaryStatus == CL_SUCCESS)
+	{
+		error = clBuildProgram(program, 1, &device, options, NULL, NULL);
+		if(error == CL_SUCCESS)
+			return program;
+	}
+
+	// Driver rejected the binary (e.g. after an update it does not report); rebuild from source.
+	if(program != NULL)
+		clReleaseProgram(program);
+	m_loadFailures++;
+	oclRemoveFile(path);
+	return NULL;
+}
+
+void oclProgramCache::storeBinary(cl_program program, cl_device_id device, const std::string& path, const std::string& key)
+{
+	cl_uint deviceCount = 0;
+	if( clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(deviceCount), &deviceCount, NULL) != CL_SUCCESS || deviceCount == 0 )
+		return;
+
+	std::vector<cl_device_id> devices(deviceCount);
+	std::vector<size_t> sizes(deviceCount);
+	if( clGetProgramInfo(program, CL_PROGRAM_DEVICES, deviceCount * sizeof(cl_device_id), &devices[0], NULL) != CL_SUCCESS ||
+		clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, deviceCount * sizeof(size_t), &sizes[0], NULL) != CL_SUCCESS )
+		return;
+
+	size_t index = std::find(devices.begin(), devices.end(), device) - devices.begin();
+	if(index == deviceCount || sizes[index] == 0)
+		return;
+
+	// CL_PROGRAM_BINARIES wants a destination for every device of the program.
+	std::vector< std::vector<unsigned char> > binaries(deviceCount);
+	std::vector<unsigned char*> pointers(deviceCount);
+	for(cl_uint i = 0; i < deviceCount; i++)
+	{
+		binaries[i].resize(sizes[i] > 0 ? sizes[i] : 1);
+		pointers[i] = &binaries[i][0];
+	}
+	if( clGetProgramInfo(program, CL_PROGRAM_BINARIES, deviceCount * sizeof(unsigned char*), &pointers[0], NULL) != CL_SUCCESS )
+		return;
+
+	oclCacheHeader header;
+	memcpy(header.magic, oclCacheMagic, sizeof(header.magic));
+	header.formatVersion = oclCacheFormatVersion;
+	header.keyLength = (cl_uint)key.size();
+	header.reserved = 0;
+	header.binarySize = sizes[index];
+
+	std::vector<unsigned char> data(sizeof(header) + key.size() + sizes[index]);
+	memcpy(&data[0], &header, sizeof(header));
+	memcpy(&data[sizeof(header)], key.data(), key.size());
+	memcpy(&data[sizeof(header) + key.size()], &binaries[index][0], sizes[index]);
+
+	if( oclWriteFileAtomic(path, &data[0], data.size()) )
+	{
+		m_stores++;
+		evict();
+	}
+}
+
+void oclProgramCache::evict()
+{
+	std::lock_guard<std::mutex> lock(m_evictMutex);
+
+	std::vector<std::string> names;
+	if( !oclListDirectory(m_directory, &names) )
+		return;
+
+	struct Entry
+	{
+		std::string path;
+		oclFileStat stat;
+	};
+	std::vector<Entry> entries;
+	cl_ulong totalBytes = 0;
+	for(size_t i = 0; i < names.size(); i++)
+	{
+		if( !oclHasSuffix(names[i], oclCacheExtension) )
+			continue;
+		Entry entry;
+		entry.path = oclJoinPath(m_directory, names[i]);
+		if( !oclStatFile(entry.path, &entry.stat) )
+			continue;
+		totalBytes += entry.stat.size;
+		entries.push_back(entry);
+	}
+	if(totalBytes <= m_maxBytes)
+		return;
+
+	// Hits touch their entry, so the oldest modification time is the least recently used.
+	std::sort(entries.begin(), entries.end(),
+		[](const Entry& a, const Entry& b) { return a.stat.mtime < b.stat.mtime; });
+	for(size_t i = 0; i < entries.size() && totalBytes > m_maxBytes; i++)
+	{
+		if( oclRemoveFile(entries[i].path) )
+		{
+			totalBytes -= entries[i].stat.size;
+			m_evictions++;
+		}
+	}
+}
+
+oclProgramCacheStats oclProgramCache::stats() const
+{
+	oclProgramCacheStats stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.stores = m_stores;
+	stats.evictions = m_evictions;
+	stats.loadFailures = m_loadFailures;
+	return stats;
+}
+
+void oclProgramCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_evictMutex);
+
+	std::vector<std::string> names;
+	if( !oclListDirectory(m_directory, &names) )
+		return;
+	for(size_t i = 0; i < names.size(); i++)
+	{
+		if( oclHasSuffix(names[i], oclCacheExtension) )
+			oclRemoveFile(oclJoinPath(m_directory, names[i]));
+	}
+}
+
+oclProgramCache* oclGetDefaultProgramCache()
+{
+	static oclProgramCache* cache = NULL;
+	static std::once_flag once;
+	std::call_once(once, []()
+	{
+		const char* directory = getenv(OCL_UTIL_CACHE_DIR_ENV);
+		cache = new oclProgramCache(directory && *directory ? directory : ".oclcache");
+	});
+	return cache;
+}
+
+cl_program oclBuildProgramCached(cl_context context, cl_device_id device, const char* source, size_t length,
+	const char* options, cl_int* error)
+{
+	return oclGetDefaultProgramCache()->build(context, device, source, length, options, error);
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclRegistry.h>
+
+static std::string oclQueryPlatformString(cl_platform_id platform, cl_platform_info param)
+{
+	size_t size = 0;
+	if( clGetPlatformInfo(platform, param, 0, NULL, &size) != CL_SUCCESS || size == 0 )
+		return std::string();
+
+	std::vector<char> buffer(size + 1, '\0');
+	if( clGetPlatformInfo(platform, param, size, &buffer[0], NULL) != CL_SUCCESS )
+		return std::string();
+	return std::string(&buffer[0]);
+}
+
+static void oclProbePlatform(oclPlatformEntry* entry)
+{
+	entry->profile = oclQueryPlatformString(entry->platform, CL_PLATFORM_PROFILE);
+	entry->version = oclQueryPlatformString(entry->platform, CL_PLATFORM_VERSION);
+	entry->name = oclQueryPlatformString(entry->platform, CL_PLATFORM_NAME);
+	entry->vendor = oclQueryPlatformString(entry->platform, CL_PLATFORM_VENDOR);
+	entry->extensions = oclQueryPlatformString(entry->platform, CL_PLATFORM_EXTENSIONS);
+
+	cl_uint deviceCount = 0;
+	if( clGetDeviceIDs(entry->platform, CL_DEVICE_TYPE_ALL, 0, NULL, &deviceCount) != CL_SUCCESS || deviceCount == 0 )
+		return;
+
+	std::vector<cl_device_id> devices(deviceCount);
+	if( clGetDeviceIDs(entry->platform, CL_DEVICE_TYPE_ALL, deviceCount, &devices[0], NULL) != CL_SUCCESS )
+		return;
+
+	for(cl_uint i = 0; i < deviceCount; i++)
+	{
+		const oclDeviceInfo* info = oclGetDeviceInfo(devices[i]);
+		if(info == NULL)
+			continue;
+		entry->devices.push_back(devices[i]);
+		entry->deviceInfo.push_back(info);
+	}
+}
+
+static oclRegistry* oclBuildRegistry()
+{
+	oclRegistry* registry = new oclRegistry();
+
+	cl_uint num_platforms = 0;
+	registry->error = clGetPlatformIDs(0, NULL, &num_platforms);
+	if( !oclHandleErrorMessage("Getting platforms", registry->error) || num_platforms == 0 )
+		return registry;
+
+	std::vector<cl_platform_id> platforms(num_platforms);
+	registry->error = clGetPlatformIDs(num_platforms, &platforms[0], NULL);
+	if( !oclHandleErrorMessage("Getting platform list", registry->error) )
+		return registry;
+
+	registry->platforms.resize(num_platforms);
+	for(cl_uint i = 0; i < num_platforms; i++)
+		registry->platforms[i].platform = platforms[i];
+
+	// Each ICD is probed on its own thread; driver initialisation dominates here.
+	if(num_platforms == 1)
+	{
+		oclProbePlatform(&registry->platforms[0]);
+	}
+	else
+	{
+		std::vector<std::thread> probes;
+		for(cl_uint i = 0; i < num_platforms; i++)
+			probes.push_back(std::thread(oclProbePlatform, &registry->platforms[i]));
+		for(size_t i = 0; i < probes.size(); i++)
+			probes[i].join();
+	}
+
+	return registry;
+}
+
+const oclRegistry* oclGetRegistry()
+{
+	static std::atomic<const oclRegistry*> registry(NULL);
+	static std::mutex initMutex;
+
+	const oclRegistry* current = registry.load(std::memory_order_acquire);
+	if(current != NULL)
+		return current;
+
+	std::lock_guard<std::mutex> lock(initMutex);
+	current = registry.load(std::memory_order_relaxed);
+	if(current == NULL)
+	{
+		current = oclBuildRegistry();
+		registry.store(current, std::memory_order_release);
+	}
+	return current;
+}
+
+const oclPlatformEntry* oclRegistry::findPlatform(cl_platform_id platform) const
+{
+	for(size_t i = 0; i < platforms.size(); i++)
+	{
+		if(platforms[i].platform == platform)
+			return &platforms[i];
+	}
+	return NULL;
+}
+
+std::vector<cl_device_id> oclRegistry::devices(cl_platform_id platform, cl_device_type deviceType) const
+{
+	std::vector<cl_device_id> result;
+	const oclPlatformEntry* entry = findPlatform(platform);
+	if(entry == NULL)
+		return result;
+
+	for(size_t i = 0; i < entry->devices.size(); i++)
+	{
+		if( entry->deviceInfo[i]->type & deviceType )
+			result.push_back(entry->devices[i]);
+	}
+	return result;
+}
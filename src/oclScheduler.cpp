@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <utility>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceSelect.h>
+#include <oclScheduler.h>
+
+oclScheduler::oclScheduler()
+{
+}
+
+oclScheduler::~oclScheduler()
+{
+	destroy();
+}
+
+bool oclScheduler::create(const oclContext& context, bool measureThroughput)
+{
+	destroy();
+	if(context.context == NULL || context.deviceCount() == 0)
+		return false;
+
+	// Only the context's devices, and measured once per process.
+	std::vector<double> weights(context.deviceCount(), 1.0);
+	for(cl_uint i = 0; i < context.deviceCount(); i++)
+	{
+		const double throughput = oclGetDeviceThroughput(context.devices[i], measureThroughput);
+		if(throughput > 0.0)
+			weights[i] = throughput;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(cl_uint i = 0; i < context.deviceCount(); i++)
+	{
+		DeviceQueue queue;
+		queue.device = context.devices[i];
+		queue.queue = ocl::Queue::retain(context.queues[i]);
+		queue.weight = weights[i];
+		queue.outstanding = 0.0;
+		queue.dispatched = 0;
+		m_queues.push_back(std::move(queue));
+	}
+	return true;
+}
+
+void oclScheduler::destroy()
+{
+	finish();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queues.clear();
+}
+
+void oclScheduler::setWeight(cl_uint deviceIndex, double weight)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(deviceIndex < m_queues.size() && weight > 0.0)
+		m_queues[deviceIndex].weight = weight;
+}
+
+void oclScheduler::pollLocked()
+{
+	for(size_t q = 0; q < m_queues.size(); q++)
+	{
+		DeviceQueue& queue = m_queues[q];
+		size_t kept = 0;
+		for(size_t i = 0; i < queue.pending.size(); i++)
+		{
+			cl_int status = CL_COMPLETE;
+			clGetEventInfo(queue.pending[i].event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+			// Negative values are errors; they won't complete either.
+			if(status <= CL_COMPLETE)
+				queue.outstanding -= queue.pending[i].cost;
+			else
+				queue.pending[kept++] = std::move(queue.pending[i]);
+		}
+		queue.pending.resize(kept);
+		if(kept == 0)
+			queue.outstanding = 0.0; // drop accumulated rounding error
+	}
+}
+
+cl_uint oclScheduler::pickLocked(double cost)
+{
+	pollLocked();
+
+	cl_uint best = 0;
+	double bestFinish = 0.0;
+	for(cl_uint i = 0; i < m_queues.size(); i++)
+	{
+		// Estimated time until this device would be done with the new work too.
+		const double finish = (m_queues[i].outstanding + cost) / m_queues[i].weight;
+		if(i == 0 || finish < bestFinish)
+		{
+			best = i;
+			bestFinish = finish;
+		}
+	}
+	return best;
+}
+
+cl_uint oclScheduler::pick(double cost)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return pickLocked(cost);
+}
+
+void oclScheduler::track(cl_uint deviceIndex, cl_event event, double cost)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(deviceIndex >= m_queues.size() || event == NULL)
+		return;
+
+	Pending pending;
+	pending.event = ocl::Event::retain(event);
+	pending.cost = cost;
+	m_queues[deviceIndex].pending.push_back(std::move(pending));
+	m_queues[deviceIndex].outstanding += cost;
+	m_queues[deviceIndex].dispatched++;
+}
+
+cl_int oclScheduler::enqueueKernel(cl_kernel kernel, cl_uint workDim, const size_t* globalWorkSize,
+	const size_t* localWorkSize, cl_uint waitCount, const cl_event* waitList,
+	cl_event* event, double cost, cl_uint* deviceIndex)
+{
+	if(cost <= 0.0)
+	{
+		cost = 1.0;
+		for(cl_uint d = 0; d < workDim; d++)
+			cost *= (double)globalWorkSize[d];
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if( m_queues.empty() )
+		return CL_INVALID_COMMAND_QUEUE;
+
+	const cl_uint index = pickLocked(cost);
+	DeviceQueue& queue = m_queues[index];
+
+	ocl::Event launched;
+	cl_int error = clEnqueueNDRangeKernel(queue.queue, kernel, workDim, NULL, globalWorkSize, localWorkSize,
+		waitCount, waitList, launched.out());
+	if( !oclHandleErrorMessage("Enqueueing scheduled kernel", error) )
+		return error;
+
+	// Flush so the device starts on it; the load estimate assumes submitted work is progressing.
+	clFlush(queue.queue);
+
+	if(event != NULL)
+		*event = launched.share().detach();
+
+	Pending pending;
+	pending.event = std::move(launched);
+	pending.cost = cost;
+	queue.pending.push_back(std::move(pending));
+	queue.outstanding += cost;
+	queue.dispatched++;
+	if(deviceIndex != NULL)
+		*deviceIndex = index;
+	return CL_SUCCESS;
+}
+
+double oclScheduler::outstanding(cl_uint deviceIndex)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	pollLocked();
+	return deviceIndex < m_queues.size() ? m_queues[deviceIndex].outstanding : 0.0;
+}
+
+cl_int oclScheduler::flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	cl_int result = CL_SUCCESS;
+	for(size_t i = 0; i < m_queues.size(); i++)
+	{
+		cl_int error = clFlush(m_queues[i].queue);
+		if(result == CL_SUCCESS)
+			result = error;
+	}
+	return result;
+}
+
+cl_int oclScheduler::finish()
+{
+	// Other threads keep picking and enqueueing while this one waits.
+	std::vector<ocl::Queue> queues;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(size_t i = 0; i < m_queues.size(); i++)
+			queues.push_back(m_queues[i].queue.share());
+	}
+
+	cl_int result = CL_SUCCESS;
+	for(size_t i = 0; i < queues.size(); i++)
+	{
+		cl_int error = clFinish(queues[i]);
+		if(result == CL_SUCCESS)
+			result = error;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	pollLocked();
+	return result;
+}
+
+oclSchedulerStats oclScheduler::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	oclSchedulerStats stats;
+	for(size_t i = 0; i < m_queues.size(); i++)
+	{
+		stats.dispatched.push_back(m_queues[i].dispatched);
+		stats.weights.push_back(m_queues[i].weight);
+	}
+	return stats;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#  include "oclWindows.h"
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclSource.h>
+#include "oclFileUtil.h"
+
+// Owns one read-only mapping of a whole file.
+class oclMappedFile
+{
+public:
+	oclMappedFile() : m_data(NULL), m_length(0)
+#ifdef _WIN32
+		, m_mapping(NULL)
+#endif
+	{}
+
+	~oclMappedFile()
+	{
+#ifdef _WIN32
+		if(m_data) UnmapViewOfFile(m_data);
+		if(m_mapping) CloseHandle(m_mapping);
+#else
+		if(m_data) munmap(m_data, m_length);
+#endif
+	}
+
+	bool open(const std::string& path, oclFileStat* stat)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if(file == INVALID_HANDLE_VALUE)
+			return false;
+
+		BY_HANDLE_FILE_INFORMATION info;
+		if( !GetFileInformationByHandle(file, &info) )
+		{
+			CloseHandle(file);
+			return false;
+		}
+		stat->size = ((cl_ulong)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+		stat->mtime = (((cl_ulong)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime) * 100;
+
+		if(stat->size > 0)
+		{
+			m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if(m_mapping != NULL)
+				m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+		CloseHandle(file);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0)
+			return false;
+
+		struct stat st;
+		if( fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) )
+		{
+			close(fd);
+			return false;
+		}
+		stat->size = (cl_ulong)st.st_size;
+#if defined(__APPLE__)
+		stat->mtime = (cl_ulong)st.st_mtimespec.tv_sec * 1000000000ULL + st.st_mtimespec.tv_nsec;
+#else
+		stat->mtime = (cl_ulong)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+
+		if(stat->size > 0)
+		{
+			void* data = mmap(NULL, (size_t)stat->size, PROT_READ, MAP_PRIVATE, fd, 0);
+			m_data = data == MAP_FAILED ? NULL : data;
+		}
+		close(fd);
+#endif
+		m_length = (size_t)stat->size;
+		return m_length == 0 || m_data != NULL;
+	}
+
+	const char* data() const { return m_length > 0 ? (const char*)m_data : ""; }
+	size_t length() const { return m_length; }
+
+private:
+	oclMappedFile(const oclMappedFile&);
+	oclMappedFile& operator=(const oclMappedFile&);
+
+	void* m_data;
+	size_t m_length;
+#ifdef _WIN32
+	HANDLE m_mapping;
+#endif
+};
+
+struct oclSourceCacheEntry
+{
+	oclFileStat stat;
+	std::shared_ptr<oclMappedFile> file;
+};
+
+static std::mutex oclSourceCacheMutex;
+static std::map<std::string, oclSourceCacheEntry> oclSourceCache;
+
+static bool oclMapProgramSourceLocked(const std::string& path, oclSourceView* view)
+{
+	oclFileStat current;
+	std::map<std::string, oclSourceCacheEntry>::iterator it = oclSourceCache.find(path);
+	if( it != oclSourceCache.end() && oclStatFile(path, &current) &&
+		current.size == it->second.stat.size && current.mtime == it->second.stat.mtime )
+	{
+		view->data = it->second.file->data();
+		view->length = it->second.file->length();
+		view->owner = it->second.file;
+		return true;
+	}
+
+	oclSourceCacheEntry entry;
+	entry.file = std::make_shared<oclMappedFile>();
+	if( !entry.file->open(path, &entry.stat) )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Unable to open %s for reading\n", path.c_str());
+		if( it != oclSourceCache.end() )
+			oclSourceCache.erase(it);
+		return false;
+	}
+
+	oclSourceCache[path] = entry;
+	view->data = entry.file->data();
+	view->length = entry.file->length();
+	view->owner = entry.file;
+	return true;
+}
+
+bool oclMapProgramSource(const char* filename, oclSourceView* view)
+{
+	std::lock_guard<std::mutex> lock(oclSourceCacheMutex);
+	return oclMapProgramSourceLocked(filename, view);
+}
+
+bool oclMapProgramSources(const char* const* filenames, cl_uint count, std::vector<oclSourceView>* views)
+{
+	std::lock_guard<std::mutex> lock(oclSourceCacheMutex);
+	views->assign(count, oclSourceView());
+	for(cl_uint i = 0; i < count; i++)
+	{
+		if( !oclMapProgramSourceLocked(filenames[i], &(*views)[i]) )
+		{
+			views->clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+cl_program oclCreateProgramFromFiles(cl_context context, const char* const* filenames, cl_uint count, cl_int* error)
+{
+	cl_int localError;
+	if(error == NULL)
+		error = &localError;
+
+	std::vector<oclSourceView> views;
+	if( count == 0 || !oclMapProgramSources(filenames, count, &views) )
+	{
+		*error = CL_INVALID_VALUE;
+		return NULL;
+	}
+
+	std::vector<const char*> strings(count);
+	std::vector<size_t> lengths(count);
+	for(cl_uint i = 0; i < count; i++)
+	{
+		strings[i] = views[i].data;
+		lengths[i] = views[i].length;
+	}
+
+	// The runtime copies the strings, so the views may be dropped afterwards.
+	cl_program program = clCreateProgramWithSource(context, count, &strings[0], &lengths[0], error);
+	if( !oclHandleErrorMessage("Creating program from files", *error) )
+		return NULL;
+	return program;
+}
+
+void oclClearSourceCache()
+{
+	std::lock_guard<std::mutex> lock(oclSourceCacheMutex);
+	oclSourceCache.clear();
+}
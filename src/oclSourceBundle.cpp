@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclSource.h>
+#include <oclSourceBundle.h>
+#include <oclProgramCache.h>
+#include "oclFileUtil.h"
+
+struct oclBundleState
+{
+	const std::vector<std::string>* includePaths;
+	oclSourceBundle* bundle;
+	std::map<std::string, size_t> indexOf;
+	std::vector<std::string> stack;
+	std::set<std::string> onceFiles;
+};
+
+static std::string oclLineDirective(size_t line, const std::string& path)
+{
+	std::string escaped(path);
+	std::replace(escaped.begin(), escaped.end(), '\\', '/');
+	char number[32];
+	sprintf(number, "#line %u \"", (unsigned int)line);
+	return number + escaped + "\"\n";
+}
+
+// If line is a preprocessor directive, returns the position just after "#" and spaces.
+static bool oclDirectiveStart(const char* line, const char* end, const char** directive)
+{
+	while(line < end && (*line == ' ' || *line == '\t'))
+		line++;
+	if(line == end || *line != '#')
+		return false;
+	line++;
+	while(line < end && (*line == ' ' || *line == '\t'))
+		line++;
+	*directive = line;
+	return true;
+}
+
+static bool oclMatchWord(const char* p, const char* end, const char* word, const char** after)
+{
+	const size_t length = strlen(word);
+	if( (size_t)(end - p) < length || strncmp(p, word, length) != 0 )
+		return false;
+	p += length;
+	if( p < end && (isalnum((unsigned char)*p) || *p == '_') )
+		return false;
+	*after = p;
+	return true;
+}
+
+// Parses the target of an #include directive. angled is set for <...> includes.
+static bool oclParseInclude(const char* p, const char* end, std::string* name, bool* angled)
+{
+	if( !oclMatchWord(p, end, "include", &p) )
+		return false;
+	while(p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	if(p == end || (*p != '"' && *p != '<'))
+		return false;
+
+	const char close = *p == '"' ? '"' : '>';
+	*angled = close == '>';
+	const char* start = ++p;
+	while(p < end && *p != close)
+		p++;
+	if(p == end)
+		return false;
+	name->assign(start, p);
+	return !name->empty();
+}
+
+static bool oclIsPragmaOnce(const char* p, const char* end)
+{
+	if( !oclMatchWord(p, end, "pragma", &p) )
+		return false;
+	while(p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return oclMatchWord(p, end, "once", &p);
+}
+
+// Updates the block comment state for one line, ignoring comment markers in literals.
+static void oclScanComments(const char* p, const char* end, bool* inBlockComment)
+{
+	char quote = 0;
+	while(p < end)
+	{
+		if(*inBlockComment)
+		{
+			if(p + 1 < end && p[0] == '*' && p[1] == '/')
+			{
+				*inBlockComment = false;
+				p++;
+			}
+		}
+		else if(quote)
+		{
+			if(*p == '\\')
+				p++;
+			else if(*p == quote)
+				quote = 0;
+		}
+		else if(*p == '"' || *p == '\'')
+			quote = *p;
+		else if(p + 1 < end && p[0] == '/' && p[1] == '/')
+			return;
+		else if(p + 1 < end && p[0] == '/' && p[1] == '*')
+		{
+			*inBlockComment = true;
+			p++;
+		}
+		p++;
+	}
+}
+
+static bool oclResolveInclude(const oclBundleState& state, const std::string& includer, const std::string& name,
+	bool angled, std::string* resolved)
+{
+	oclFileStat stat;
+	if(!angled)
+	{
+		std::string candidate = oclDirectoryOf(includer) + name;
+		if( oclStatFile(candidate, &stat) )
+		{
+			*resolved = oclCanonicalPath(candidate);
+			return true;
+		}
+	}
+	for(size_t i = 0; i < state.includePaths->size(); i++)
+	{
+		std::string candidate = oclJoinPath((*state.includePaths)[i], name);
+		if( oclStatFile(candidate, &stat) )
+		{
+			*resolved = oclCanonicalPath(candidate);
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool oclExpandFile(oclBundleState& state, const std::string& path, size_t* index)
+{
+	if( std::find(state.stack.begin(), state.stack.end(), path) != state.stack.end() )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Circular #include of %s\n", path.c_str());
+		return false;
+	}
+
+	oclSourceView view;
+	if( !oclMapProgramSource(path.c_str(), &view) )
+		return false;
+
+	std::map<std::string, size_t>::iterator known = state.indexOf.find(path);
+	if( known == state.indexOf.end() )
+	{
+		oclSourceDependency dependency;
+		dependency.path = path;
+		dependency.contentHash = oclHashBytes(view.data, view.length);
+		oclFileStat stat;
+		if( !oclStatFile(path, &stat) )
+			stat.size = stat.mtime = 0;
+		dependency.size = stat.size;
+		dependency.mtime = stat.mtime;
+		*index = state.bundle->dependencies.size();
+		state.indexOf[path] = *index;
+		state.bundle->dependencies.push_back(dependency);
+	}
+	else
+	{
+		*index = known->second;
+	}
+
+	if( state.onceFiles.count(path) )
+		return true;
+
+	std::string& out = state.bundle->source;
+	out += oclLineDirective(1, path);
+
+	state.stack.push_back(path);
+	const char* p = view.data;
+	const char* end = view.data + view.length;
+	size_t lineNumber = 1;
+	bool inBlockComment = false;
+	while(p < end)
+	{
+		const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+		const char* next = lineEnd ? lineEnd + 1 : end;
+		if(!lineEnd)
+			lineEnd = end;
+
+		const char* directive;
+		std::string name;
+		bool angled;
+		bool handled = false;
+		if( !inBlockComment && oclDirectiveStart(p, lineEnd, &directive) )
+		{
+			if( oclIsPragmaOnce(directive, lineEnd) )
+			{
+				state.onceFiles.insert(path);
+				out += "\n";
+				handled = true;
+			}
+			else if( oclParseInclude(directive, lineEnd, &name, &angled) )
+			{
+				std::string resolved;
+				if( oclResolveInclude(state, path, name, angled, &resolved) )
+				{
+					size_t childIndex;
+					if( !oclExpandFile(state, resolved, &childIndex) )
+					{
+						state.stack.pop_back();
+						return false;
+					}
+					std::vector<size_t>& includes = state.bundle->dependencies[*index].includes;
+					if( std::find(includes.begin(), includes.end(), childIndex) == includes.end() )
+						includes.push_back(childIndex);
+					out += oclLineDirective(lineNumber + 1, path);
+					handled = true;
+				}
+				else if(oclGetVerbosity() > 0)
+				{
+					printf("Could not resolve #include %c%s%c in %s, leaving it to the compiler\n",
+						angled ? '<' : '"', name.c_str(), angled ? '>' : '"', path.c_str());
+				}
+			}
+		}
+
+		if(!handled)
+		{
+			out.append(p, lineEnd);
+			out += "\n";
+		}
+		oclScanComments(p, lineEnd, &inBlockComment);
+		p = next;
+		lineNumber++;
+	}
+	state.stack.pop_back();
+	return true;
+}
+
+bool oclBundleProgramSource(const char* filename, const std::vector<std::string>& includePaths, oclSourceBundle* bundle)
+{
+	oclSourceBundle result;
+	oclBundleState state;
+	state.includePaths = &includePaths;
+	state.bundle = &result;
+
+	size_t rootIndex;
+	if( !oclExpandFile(state, oclCanonicalPath(filename), &rootIndex) )
+		return false;
+
+	cl_ulong hash = OCL_HASH_SEED;
+	for(size_t i = 0; i < result.dependencies.size(); i++)
+	{
+		hash = oclHashString(result.dependencies[i].path, hash);
+		hash = oclHashBytes(&result.dependencies[i].contentHash, sizeof(cl_ulong), hash);
+	}
+	result.hash = hash;
+
+	*bundle = result;
+	return true;
+}
+
+bool oclSourceBundleIsStale(oclSourceBundle* bundle)
+{
+	if( bundle->dependencies.empty() )
+		return true;
+
+	for(size_t i = 0; i < bundle->dependencies.size(); i++)
+	{
+		oclSourceDependency& dependency = bundle->dependencies[i];
+		oclFileStat stat;
+		if( !oclStatFile(dependency.path, &stat) )
+			return true;
+		if( stat.size == dependency.size && stat.mtime == dependency.mtime )
+			continue;
+
+		// Touched or rewritten; only a content change counts.
+		oclSourceView view;
+		if( !oclMapProgramSource(dependency.path.c_str(), &view) )
+			return true;
+		if( oclHashBytes(view.data, view.length) != dependency.contentHash )
+			return true;
+		// Same content: remember the new stat so the next check is cheap again.
+		dependency.size = stat.size;
+		dependency.mtime = stat.mtime;
+	}
+	return false;
+}
+
+bool oclRefreshSourceBundle(const char* filename, const std::vector<std::string>& includePaths, oclSourceBundle* bundle)
+{
+	if( !oclSourceBundleIsStale(bundle) )
+		return true;
+	return oclBundleProgramSource(filename, includePaths, bundle);
+}
+
+cl_program oclBuildBundledProgram(cl_context context, cl_device_id device, const oclSourceBundle& bundle,
+	const char* options, cl_int* error)
+{
+	return oclBuildProgramCached(context, device, bundle.source.data(), bundle.source.size(), options, error);
+}
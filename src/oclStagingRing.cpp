@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclStagingRing.h>
+
+oclStagingRing::oclStagingRing()
+	: m_queue(NULL)
+	, m_slotSize(0)
+	, m_next(0)
+	, m_acquired(NULL)
+{
+}
+
+oclStagingRing::~oclStagingRing()
+{
+	destroy();
+}
+
+bool oclStagingRing::create(cl_context context, cl_command_queue queue, size_t slotSize, cl_uint slotCount)
+{
+	destroy();
+	if(slotSize == 0 || slotCount == 0)
+		return false;
+
+	m_queue = queue;
+	clRetainCommandQueue(m_queue);
+	m_slotSize = slotSize;
+
+	for(cl_uint i = 0; i < slotCount; i++)
+	{
+		cl_int error;
+		Slot slot;
+		slot.inFlight = NULL;
+		slot.buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, slotSize, NULL, &error);
+		if( !oclHandleErrorMessage("Creating pinned staging buffer", error) )
+		{
+			destroy();
+			return false;
+		}
+
+		// Mapped once; the pointer stays valid until destroy.
+		slot.host = clEnqueueMapBuffer(m_queue, slot.buffer, CL_TRUE, CL_MAP_WRITE, 0, slotSize, 0, NULL, NULL, &error);
+		if( !oclHandleErrorMessage("Mapping pinned staging buffer", error) )
+		{
+			clReleaseMemObject(slot.buffer);
+			destroy();
+			return false;
+		}
+		m_slots.push_back(slot);
+	}
+	return true;
+}
+
+void oclStagingRing::destroy()
+{
+	if(m_queue == NULL)
+		return;
+
+	finish();
+	for(size_t i = 0; i < m_slots.size(); i++)
+	{
+		clEnqueueUnmapMemObject(m_queue, m_slots[i].buffer, m_slots[i].host, 0, NULL, NULL);
+		clReleaseMemObject(m_slots[i].buffer);
+	}
+	clFinish(m_queue);
+	clReleaseCommandQueue(m_queue);
+
+	m_slots.clear();
+	m_queue = NULL;
+	m_slotSize = 0;
+	m_next = 0;
+	m_acquired = NULL;
+}
+
+oclStagingRing::Slot* oclStagingRing::nextSlot()
+{
+	Slot* slot = &m_slots[m_next];
+	m_next = (m_next + 1) % m_slots.size();
+
+	if(slot->inFlight != NULL)
+	{
+		clWaitForEvents(1, &slot->inFlight);
+		clReleaseEvent(slot->inFlight);
+		slot->inFlight = NULL;
+	}
+	return slot;
+}
+
+cl_int oclStagingRing::upload(cl_mem dst, size_t dstOffset, const void* src, size_t size, cl_event* event)
+{
+	if(m_slots.empty() || m_acquired != NULL)
+		return CL_INVALID_OPERATION;
+
+	const char* bytes = (const char*)src;
+	cl_int error = CL_SUCCESS;
+	while(size > 0 && error == CL_SUCCESS)
+	{
+		const size_t chunk = size < m_slotSize ? size : m_slotSize;
+		Slot* slot = nextSlot();
+		memcpy(slot->host, bytes, chunk);
+
+		error = clEnqueueWriteBuffer(m_queue, dst, CL_FALSE, dstOffset, chunk, slot->host, 0, NULL, &slot->inFlight);
+		if(error != CL_SUCCESS)
+		{
+			slot->inFlight = NULL;
+			break;
+		}
+
+		bytes += chunk;
+		dstOffset += chunk;
+		size -= chunk;
+
+		if(size == 0 && event != NULL)
+		{
+			clRetainEvent(slot->inFlight);
+			*event = slot->inFlight;
+		}
+	}
+
+	// Kick the DMA off now rather than at the next blocking call.
+	clFlush(m_queue);
+	return error;
+}
+
+void* oclStagingRing::acquire()
+{
+	if(m_slots.empty() || m_acquired != NULL)
+		return NULL;
+	m_acquired = nextSlot();
+	return m_acquired->host;
+}
+
+cl_int oclStagingRing::commit(cl_mem dst, size_t dstOffset, size_t size, cl_event* event)
+{
+	if(m_acquired == NULL || size > m_slotSize)
+		return CL_INVALID_OPERATION;
+
+	Slot* slot = m_acquired;
+	m_acquired = NULL;
+
+	cl_int error = clEnqueueWriteBuffer(m_queue, dst, CL_FALSE, dstOffset, size, slot->host, 0, NULL, &slot->inFlight);
+	if(error != CL_SUCCESS)
+	{
+		slot->inFlight = NULL;
+		return error;
+	}
+	if(event != NULL)
+	{
+		clRetainEvent(slot->inFlight);
+		*event = slot->inFlight;
+	}
+	return clFlush(m_queue);
+}
+
+cl_int oclStagingRing::flush()
+{
+	return m_queue ? clFlush(m_queue) : CL_INVALID_COMMAND_QUEUE;
+}
+
+cl_int oclStagingRing::finish()
+{
+	cl_int error = CL_SUCCESS;
+	for(size_t i = 0; i < m_slots.size(); i++)
+	{
+		if(m_slots[i].inFlight != NULL)
+		{
+			cl_int waitError = clWaitForEvents(1, &m_slots[i].inFlight);
+			if(waitError != CL_SUCCESS)
+				error = waitError;
+			clReleaseEvent(m_slots[i].inFlight);
+			m_slots[i].inFlight = NULL;
+		}
+	}
+	return error;
+}
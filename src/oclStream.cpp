@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclMemoryBudget.h>
+#include <oclStream.h>
+
+// Default input per chunk when chunkElements is 0.
+static const size_t oclStreamDefaultChunkBytes = 32 * 1024 * 1024;
+
+oclStreamExecutor::oclStreamExecutor()
+	: m_device(NULL)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+oclStreamExecutor::~oclStreamExecutor()
+{
+	destroy();
+}
+
+size_t oclStreamExecutor::outputElementSize() const
+{
+	return m_options.outputElementSize ? m_options.outputElementSize : m_options.inputElementSize;
+}
+
+bool oclStreamExecutor::create(cl_context context, cl_device_id device, const oclStreamOptions& options)
+{
+	destroy();
+
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	oclMemoryBudget* budget = oclGetMemoryBudget(device);
+	if(info == NULL || budget == NULL || options.inputElementSize == 0 || options.depth < 2)
+		return false;
+
+	m_context = ocl::Context::retain(context);
+	m_device = device;
+	m_options = options;
+
+	cl_int error;
+	ocl::Queue* queues[3] = { &m_uploadQueue, &m_computeQueue, &m_downloadQueue };
+	for(int i = 0; i < 3; i++)
+	{
+		queues[i]->reset(clCreateCommandQueue(context, device, 0, &error));
+		if( !oclHandleErrorMessage("Creating stream queue", error) )
+		{
+			destroy();
+			return false;
+		}
+	}
+
+	const size_t largest = std::max(m_options.inputElementSize, m_options.outputElementSize);
+	const size_t deviceBytesPerElement = m_options.inputElementSize + m_options.outputElementSize;
+	if(m_options.chunkElements == 0)
+	{
+		size_t chunk = oclStreamDefaultChunkBytes / m_options.inputElementSize;
+		// Keep every slot's buffers within half of what the budget has left.
+		const cl_ulong fit = budget->available() / 2 / (m_options.depth * deviceBytesPerElement);
+		if(fit < chunk)
+			chunk = (size_t)fit;
+		if(m_options.localSize > 0 && chunk > m_options.localSize)
+			chunk = chunk / m_options.localSize * m_options.localSize;
+		m_options.chunkElements = chunk;
+	}
+	if(info->maxMemAllocSize > 0 && m_options.chunkElements > info->maxMemAllocSize / largest)
+		m_options.chunkElements = (size_t)(info->maxMemAllocSize / largest);
+	// The count kernel argument is a uint.
+	if(m_options.chunkElements > 0xFFFFFFFFu)
+		m_options.chunkElements = 0xFFFFFFFFu;
+	if(m_options.chunkElements == 0)
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Device memory budget leaves no room for stream buffers\n");
+		destroy();
+		return false;
+	}
+
+	m_slots.resize(m_options.depth);
+	for(size_t i = 0; i < m_slots.size(); i++)
+	{
+		if( !createSlot(&m_slots[i]) )
+		{
+			destroy();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool oclStreamExecutor::create(const oclContext& context, cl_uint deviceIndex, const oclStreamOptions& options)
+{
+	if(deviceIndex >= context.deviceCount())
+		return false;
+	return create(context.context, context.devices[deviceIndex], options);
+}
+
+bool oclStreamExecutor::createSlot(Slot* slot)
+{
+	*slot = Slot();
+
+	const size_t inputBytes = m_options.chunkElements * m_options.inputElementSize;
+	const size_t outputBytes = m_options.chunkElements * outputElementSize();
+	cl_int error;
+
+	slot->input = oclCreateBudgetedBuffer(m_context, m_device, CL_MEM_READ_WRITE, inputBytes, NULL, &error);
+	if(error != CL_SUCCESS)
+		return false;
+	if(m_options.outputElementSize > 0)
+	{
+		slot->output = oclCreateBudgetedBuffer(m_context, m_device, CL_MEM_WRITE_ONLY, outputBytes, NULL, &error);
+		if(error != CL_SUCCESS)
+			return false;
+	}
+
+	// Pinned staging, mapped once for the lifetime of the executor.
+	slot->pinnedInput.reset(clCreateBuffer(m_context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, inputBytes, NULL, &error));
+	if( !oclHandleErrorMessage("Creating pinned stream input", error) )
+		return false;
+	slot->hostInput = clEnqueueMapBuffer(m_uploadQueue, slot->pinnedInput, CL_TRUE, CL_MAP_WRITE, 0, inputBytes, 0, NULL, NULL, &error);
+	if( !oclHandleErrorMessage("Mapping pinned stream input", error) )
+		return false;
+
+	slot->pinnedOutput.reset(clCreateBuffer(m_context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, outputBytes, NULL, &error));
+	if( !oclHandleErrorMessage("Creating pinned stream output", error) )
+		return false;
+	slot->hostOutput = clEnqueueMapBuffer(m_downloadQueue, slot->pinnedOutput, CL_TRUE, CL_MAP_READ, 0, outputBytes, 0, NULL, NULL, &error);
+	if( !oclHandleErrorMessage("Mapping pinned stream output", error) )
+		return false;
+
+	return true;
+}
+
+void oclStreamExecutor::destroy()
+{
+	ocl::Queue* queues[3] = { &m_uploadQueue, &m_computeQueue, &m_downloadQueue };
+	for(int i = 0; i < 3; i++)
+	{
+		if(*queues[i])
+			clFinish(*queues[i]);
+	}
+
+	for(size_t i = 0; i < m_slots.size(); i++)
+	{
+		Slot& slot = m_slots[i];
+		if(slot.hostInput != NULL)
+			clEnqueueUnmapMemObject(m_uploadQueue, slot.pinnedInput, slot.hostInput, 0, NULL, NULL);
+		if(slot.hostOutput != NULL)
+			clEnqueueUnmapMemObject(m_downloadQueue, slot.pinnedOutput, slot.hostOutput, 0, NULL, NULL);
+		// Budgeted buffers go back through the budget rather than a handle.
+		oclReleaseBudgetedBuffer(slot.input);
+		oclReleaseBudgetedBuffer(slot.output);
+	}
+	// Unmaps must complete before the pinned buffers go away with the slots.
+	for(int i = 0; i < 3; i++)
+	{
+		if(*queues[i])
+			clFinish(*queues[i]);
+	}
+	m_slots.clear();
+
+	for(int i = 0; i < 3; i++)
+		queues[i]->reset();
+	m_context.reset();
+	m_device = NULL;
+}
+
+cl_int oclStreamExecutor::enqueueChunk(Slot* slot, cl_kernel kernel, bool download)
+{
+	ocl::Event uploaded, computed;
+	cl_int error = clEnqueueWriteBuffer(m_uploadQueue, slot->input, CL_FALSE, 0, slot->count * m_options.inputElementSize,
+		slot->hostInput, 0, NULL, uploaded.out());
+	if( !oclHandleErrorMessage("Uploading stream chunk", error) )
+		return error;
+	clFlush(m_uploadQueue);
+
+	cl_mem output = m_options.outputElementSize > 0 ? slot->output : slot->input;
+	cl_uint count = (cl_uint)slot->count;
+	if(m_options.inputArg != OCL_UTIL_STREAM_NO_ARG)
+		error = clSetKernelArg(kernel, m_options.inputArg, sizeof(cl_mem), &slot->input);
+	if(error == CL_SUCCESS && m_options.outputArg != OCL_UTIL_STREAM_NO_ARG && m_options.outputElementSize > 0)
+		error = clSetKernelArg(kernel, m_options.outputArg, sizeof(cl_mem), &output);
+	if(error == CL_SUCCESS && m_options.countArg != OCL_UTIL_STREAM_NO_ARG)
+		error = clSetKernelArg(kernel, m_options.countArg, sizeof(cl_uint), &count);
+	if(error == CL_SUCCESS && m_options.firstArg != OCL_UTIL_STREAM_NO_ARG)
+		error = clSetKernelArg(kernel, m_options.firstArg, sizeof(cl_ulong), &slot->first);
+	if( !oclHandleErrorMessage("Setting stream kernel arguments", error) )
+		return error;
+
+	size_t global = slot->count;
+	const size_t* local = NULL;
+	if(m_options.localSize > 0)
+	{
+		global = (global + m_options.localSize - 1) / m_options.localSize * m_options.localSize;
+		local = &m_options.localSize;
+	}
+	cl_event waitUploaded = uploaded;
+	error = clEnqueueNDRangeKernel(m_computeQueue, kernel, 1, NULL, &global, local, 1, &waitUploaded, computed.out());
+	if( !oclHandleErrorMessage("Launching stream kernel", error) )
+		return error;
+	clFlush(m_computeQueue);
+
+	if( !download )
+	{
+		slot->downloaded = std::move(computed);
+		return CL_SUCCESS;
+	}
+
+	const size_t bytes = slot->count * outputElementSize();
+	cl_event waitComputed = computed;
+	error = clEnqueueReadBuffer(m_downloadQueue, output, CL_FALSE, 0, bytes, slot->hostOutput, 1, &waitComputed,
+		slot->downloaded.out());
+	if( !oclHandleErrorMessage("Downloading stream chunk", error) )
+		return error;
+	clFlush(m_downloadQueue);
+	m_stats.bytesDownloaded += bytes;
+	return CL_SUCCESS;
+}
+
+cl_int oclStreamExecutor::retireSlot(Slot* slot, const oclStreamWriter& writer)
+{
+	if( !slot->downloaded )
+		return CL_SUCCESS;
+
+	cl_event downloaded = slot->downloaded;
+	cl_int error = clWaitForEvents(1, &downloaded);
+	slot->downloaded.reset();
+	if( !oclHandleErrorMessage("Waiting for stream chunk", error) )
+		return error;
+
+	m_stats.chunks++;
+	if( writer && !writer(slot->hostOutput, slot->first, slot->count) )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Stream writer failed at element %llu\n", (unsigned long long)slot->first);
+		return CL_INVALID_VALUE;
+	}
+	return CL_SUCCESS;
+}
+
+cl_int oclStreamExecutor::run(cl_kernel kernel, cl_ulong totalElements, const oclStreamReader& reader,
+	const oclStreamWriter& writer)
+{
+	if( m_slots.empty() || !reader )
+		return CL_INVALID_OPERATION;
+
+	memset(&m_stats, 0, sizeof(m_stats));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	const bool download = (bool)writer;
+	const size_t depth = m_slots.size();
+	cl_int error = CL_SUCCESS;
+	size_t next = 0;
+
+	for(cl_ulong first = 0; first < totalElements && error == CL_SUCCESS; first += m_options.chunkElements, next++)
+	{
+		// The slot's previous chunk must be consumed before its staging is refilled.
+		Slot* slot = &m_slots[next % depth];
+		error = retireSlot(slot, writer);
+		if(error != CL_SUCCESS)
+			break;
+
+		const cl_ulong remaining = totalElements - first;
+		slot->first = first;
+		slot->count = remaining < m_options.chunkElements ? (size_t)remaining : m_options.chunkElements;
+		if( !reader(slot->hostInput, first, slot->count) )
+		{
+			if(oclGetVerbosity() > 0)
+				printf("Stream reader failed at element %llu\n", (unsigned long long)first);
+			error = CL_INVALID_VALUE;
+			break;
+		}
+
+		error = enqueueChunk(slot, kernel, download);
+		m_stats.bytesUploaded += slot->count * m_options.inputElementSize;
+	}
+
+	// Drain the chunks still in flight, oldest first.
+	for(size_t i = 0; i < depth; i++)
+	{
+		cl_int retired = retireSlot(&m_slots[(next + i) % depth], error == CL_SUCCESS ? writer : oclStreamWriter());
+		if(error == CL_SUCCESS)
+			error = retired;
+	}
+
+	m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return error;
+}
+
+oclStreamReader oclStreamFromArray(const void* data, size_t elementSize)
+{
+	const char* bytes = (const char*)data;
+	return [bytes, elementSize](void* dst, unsigned long long first, size_t count)
+	{
+		memcpy(dst, bytes + first * elementSize, count * elementSize);
+		return true;
+	};
+}
+
+oclStreamReader oclStreamFromFile(FILE* file, size_t elementSize)
+{
+	return [file, elementSize](void* dst, unsigned long long, size_t count)
+	{
+		return fread(dst, elementSize, count, file) == count;
+	};
+}
+
+oclStreamWriter oclStreamToArray(void* data, size_t elementSize)
+{
+	char* bytes = (char*)data;
+	return [bytes, elementSize](const void* src, unsigned long long first, size_t count)
+	{
+		memcpy(bytes + first * elementSize, src, count * elementSize);
+		return true;
+	};
+}
+
+oclStreamWriter oclStreamToFile(FILE* file, size_t elementSize)
+{
+	return [file, elementSize](const void* src, unsigned long long, size_t count)
+	{
+		return fwrite(src, elementSize, count, file) == count;
+	};
+}
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclTaskGraph.h>
+
+static const size_t oclNoNode = (size_t)-1;
+
+oclTaskGraph::oclTaskGraph()
+	: m_device(NULL)
+	, m_outOfOrder(false)
+{
+}
+
+oclTaskGraph::~oclTaskGraph()
+{
+	destroy();
+}
+
+bool oclTaskGraph::create(cl_context context, cl_device_id device, cl_uint inOrderQueues)
+{
+	destroy();
+
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	if(context == NULL || info == NULL)
+		return false;
+
+	m_context = ocl::Context::retain(context);
+	m_device = device;
+
+	m_outOfOrder = (info->queueProperties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+	const cl_uint queueCount = m_outOfOrder ? 1 : (inOrderQueues > 0 ? inOrderQueues : 1);
+	const cl_command_queue_properties properties = m_outOfOrder ? CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE : 0;
+
+	for(cl_uint i = 0; i < queueCount; i++)
+	{
+		cl_int error;
+		ocl::Queue queue(clCreateCommandQueue(context, device, properties, &error));
+		if( !oclHandleErrorMessage("Creating task graph queue", error) )
+		{
+			destroy();
+			return false;
+		}
+		m_queues.push_back(std::move(queue));
+	}
+	return true;
+}
+
+void oclTaskGraph::destroy()
+{
+	finish();
+	m_queues.clear();
+	m_context.reset();
+	m_device = NULL;
+	m_nodes.clear();
+}
+
+oclTaskGraph::Node oclTaskGraph::add(Task task, const Nodes& dependencies)
+{
+	task.queue = oclNoNode;
+	m_nodes.push_back(std::move(task));
+
+	const Node node = m_nodes.size() - 1;
+	for(size_t i = 0; i < dependencies.size(); i++)
+		addDependency(node, dependencies[i]);
+	return node;
+}
+
+oclTaskGraph::Node oclTaskGraph::addKernel(cl_kernel kernel, cl_uint workDim, const size_t* globalWorkSize,
+	const size_t* localWorkSize, const Nodes& dependencies)
+{
+	Task task = Task();
+	task.type = NodeKernel;
+	task.kernel = kernel;
+	task.workDim = workDim < 1 ? 1 : (workDim > 3 ? 3 : workDim);
+	task.hasLocalWorkSize = localWorkSize != NULL;
+	for(cl_uint d = 0; d < task.workDim; d++)
+	{
+		task.globalWorkSize[d] = globalWorkSize[d];
+		task.localWorkSize[d] = localWorkSize ? localWorkSize[d] : 0;
+	}
+	return add(std::move(task), dependencies);
+}
+
+oclTaskGraph::Node oclTaskGraph::addWrite(cl_mem buffer, size_t offset, size_t size, const void* data,
+	const Nodes& dependencies)
+{
+	Task task = Task();
+	task.type = NodeWrite;
+	task.buffer = buffer;
+	task.offset = offset;
+	task.size = size;
+	task.source = data;
+	return add(std::move(task), dependencies);
+}
+
+oclTaskGraph::Node oclTaskGraph::addRead(cl_mem buffer, size_t offset, size_t size, void* data,
+	const Nodes& dependencies)
+{
+	Task task = Task();
+	task.type = NodeRead;
+	task.buffer = buffer;
+	task.offset = offset;
+	task.size = size;
+	task.target = data;
+	return add(std::move(task), dependencies);
+}
+
+oclTaskGraph::Node oclTaskGraph::addCopy(cl_mem source, size_t sourceOffset, cl_mem destination,
+	size_t destinationOffset, size_t size, const Nodes& dependencies)
+{
+	Task task = Task();
+	task.type = NodeCopy;
+	task.buffer = source;
+	task.offset = sourceOffset;
+	task.destination = destination;
+	task.destinationOffset = destinationOffset;
+	task.size = size;
+	return add(std::move(task), dependencies);
+}
+
+oclTaskGraph::Node oclTaskGraph::addHost(const std::function<void()>& function, const Nodes& dependencies)
+{
+	Task task = Task();
+	task.type = NodeHost;
+	task.host = function;
+	return add(std::move(task), dependencies);
+}
+
+void oclTaskGraph::addDependency(Node node, Node dependsOn)
+{
+	if(node >= m_nodes.size() || dependsOn >= m_nodes.size() || node == dependsOn)
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Ignoring invalid task graph dependency %u -> %u\n", (unsigned int)node, (unsigned int)dependsOn);
+		return;
+	}
+	m_nodes[node].dependencies.push_back(dependsOn);
+}
+
+void oclTaskGraph::setKernelArgs(Node node, const oclTaskArgs& setArgs)
+{
+	if(node < m_nodes.size() && m_nodes[node].type == NodeKernel)
+		m_nodes[node].setArgs = setArgs;
+}
+
+void oclTaskGraph::clear()
+{
+	finish();
+	m_nodes.clear();
+}
+
+bool oclTaskGraph::schedule(std::vector<Node>* order) const
+{
+	std::vector<size_t> waiting(m_nodes.size(), 0);
+	std::vector<Nodes> dependents(m_nodes.size());
+	for(Node n = 0; n < m_nodes.size(); n++)
+	{
+		waiting[n] = m_nodes[n].dependencies.size();
+		for(size_t i = 0; i < m_nodes[n].dependencies.size(); i++)
+			dependents[m_nodes[n].dependencies[i]].push_back(n);
+	}
+
+	// Host callbacks block the submitting thread, so they are taken only when
+	// no device work is ready; that submits as much as possible before blocking.
+	std::deque<Node> deviceReady, hostReady;
+	for(Node n = 0; n < m_nodes.size(); n++)
+	{
+		if(waiting[n] == 0)
+			(m_nodes[n].type == NodeHost ? hostReady : deviceReady).push_back(n);
+	}
+
+	order->clear();
+	while( !deviceReady.empty() || !hostReady.empty() )
+	{
+		std::deque<Node>& ready = deviceReady.empty() ? hostReady : deviceReady;
+		const Node n = ready.front();
+		ready.pop_front();
+		order->push_back(n);
+
+		for(size_t i = 0; i < dependents[n].size(); i++)
+		{
+			const Node d = dependents[n][i];
+			if(--waiting[d] == 0)
+				(m_nodes[d].type == NodeHost ? hostReady : deviceReady).push_back(d);
+		}
+	}
+	return order->size() == m_nodes.size();
+}
+
+size_t oclTaskGraph::chooseQueue(const Task& task, const std::vector<Node>& queueTails,
+	const std::vector<size_t>& lastUse) const
+{
+	if(m_queues.size() == 1)
+		return 0;
+
+	// Continue a chain on its predecessor's queue, where in-order execution
+	// already provides the ordering.
+	for(size_t i = 0; i < task.dependencies.size(); i++)
+	{
+		const size_t queue = m_nodes[task.dependencies[i]].queue;
+		if(queue != oclNoNode && queueTails[queue] == task.dependencies[i])
+			return queue;
+	}
+
+	// Otherwise start a new branch on an idle queue, or the one used least recently.
+	size_t best = 0;
+	for(size_t q = 0; q < queueTails.size(); q++)
+	{
+		if(queueTails[q] == oclNoNode)
+			return q;
+		if(lastUse[q] < lastUse[best])
+			best = q;
+	}
+	return best;
+}
+
+cl_int oclTaskGraph::submit(Task* task)
+{
+	std::vector<cl_event> waitList;
+	for(size_t i = 0; i < task->dependencies.size(); i++)
+	{
+		cl_event event = m_nodes[task->dependencies[i]].event.get();
+		if( event != NULL && std::find(waitList.begin(), waitList.end(), event) == waitList.end() )
+			waitList.push_back(event);
+	}
+	const cl_uint waitCount = (cl_uint)waitList.size();
+	const cl_event* waitEvents = waitList.empty() ? NULL : &waitList[0];
+
+	if(task->type == NodeHost)
+	{
+		cl_int error = CL_SUCCESS;
+		if(waitCount > 0)
+		{
+			for(size_t q = 0; q < m_queues.size(); q++)
+				clFlush(m_queues[q]);
+			error = clWaitForEvents(waitCount, waitEvents);
+		}
+		if(error == CL_SUCCESS && task->host)
+			task->host();
+		return error;
+	}
+
+	cl_command_queue queue = m_queues[task->queue];
+	switch(task->type)
+	{
+	case NodeKernel:
+		if(task->setArgs)
+		{
+			cl_int error = task->setArgs(task->kernel);
+			if(error != CL_SUCCESS)
+				return error;
+		}
+		return clEnqueueNDRangeKernel(queue, task->kernel, task->workDim, NULL, task->globalWorkSize,
+			task->hasLocalWorkSize ? task->localWorkSize : NULL, waitCount, waitEvents, task->event.out());
+	case NodeWrite:
+		return clEnqueueWriteBuffer(queue, task->buffer, CL_FALSE, task->offset, task->size, task->source,
+			waitCount, waitEvents, task->event.out());
+	case NodeRead:
+		return clEnqueueReadBuffer(queue, task->buffer, CL_FALSE, task->offset, task->size, task->target,
+			waitCount, waitEvents, task->event.out());
+	case NodeCopy:
+		return clEnqueueCopyBuffer(queue, task->buffer, task->destination, task->offset, task->destinationOffset,
+			task->size, waitCount, waitEvents, task->event.out());
+	default:
+		return CL_INVALID_OPERATION;
+	}
+}
+
+cl_int oclTaskGraph::execute(bool wait)
+{
+	if( m_queues.empty() )
+		return CL_INVALID_COMMAND_QUEUE;
+
+	cl_int error = finish();
+	if(error != CL_SUCCESS)
+		return error;
+
+	std::vector<Node> order;
+	if( !schedule(&order) )
+	{
+		if(oclGetVerbosity() > 0)
+			printf("Task graph contains a dependency cycle\n");
+		return CL_INVALID_VALUE;
+	}
+
+	std::vector<Node> queueTails(m_queues.size(), oclNoNode);
+	std::vector<size_t> lastUse(m_queues.size(), 0);
+	for(size_t i = 0; i < order.size() && error == CL_SUCCESS; i++)
+	{
+		Task& task = m_nodes[order[i]];
+		if(task.type != NodeHost)
+		{
+			task.queue = chooseQueue(task, queueTails, lastUse);
+			queueTails[task.queue] = order[i];
+			lastUse[task.queue] = i;
+		}
+
+		// On failure event.out() has cleared the handle, so a failed node has no event.
+		error = submit(&task);
+		if(error != CL_SUCCESS && oclGetVerbosity() > 0)
+			printf("Task graph node %u failed: %s\n", (unsigned int)order[i], oclErrorString(error));
+	}
+
+	for(size_t q = 0; q < m_queues.size(); q++)
+		clFlush(m_queues[q]);
+
+	if(wait || error != CL_SUCCESS)
+	{
+		cl_int finished = finish();
+		if(error == CL_SUCCESS)
+			error = finished;
+	}
+	return error;
+}
+
+cl_int oclTaskGraph::finish()
+{
+	cl_int result = CL_SUCCESS;
+	for(size_t q = 0; q < m_queues.size(); q++)
+	{
+		cl_int error = clFinish(m_queues[q]);
+		if(result == CL_SUCCESS)
+			result = error;
+	}
+	releaseEvents();
+	return result;
+}
+
+void oclTaskGraph::releaseEvents()
+{
+	for(size_t i = 0; i < m_nodes.size(); i++)
+	{
+		m_nodes[i].event.reset();
+		m_nodes[i].queue = oclNoNode;
+	}
+}
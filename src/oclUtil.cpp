@@ -1,9 +1,17 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string>
 #include <string.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
 
 #include <CL/cl.h>
 #include <oclUtil.h>
+#include <oclDeviceInfo.h>
+#include <oclDeviceSelect.h>
+#include <oclRegistry.h>
+#include <oclSource.h>
 
 #ifdef OCL_UTIL_GL_SHARING_ENABLE
 #include "opengl.h"
@@ -40,24 +48,20 @@
 
 char *oclLoadProgramContents(const char *filename, int *length)
 {
-	FILE *f = fopen(filename, "r");
-	void *buffer;
-
-	if (!f) {
-		printf("Unable to open %s for reading\n", filename);
+	// Goes through the mapped source cache; see oclMapProgramSource for a copy free variant.
+	oclSourceView view;
+	if( !oclMapProgramSource(filename, &view) )
 		return NULL;
-	}
 
-	fseek(f, 0, SEEK_END);
-	*length = ftell(f);
-	fseek(f, 0, SEEK_SET);
+	char *buffer = (char*)malloc(view.length+1);
+	if(buffer == NULL)
+		return NULL;
 
-	buffer = malloc(*length+1);
-	*length = fread(buffer, 1, *length, f);
-	fclose(f);
-	((char*)buffer)[*length] = '\0';
+	memcpy(buffer, view.data, view.length);
+	buffer[view.length] = '\0';
+	*length = (int)view.length;
 
-	return (char*)buffer;
+	return buffer;
 }
 
 #ifdef OCL_UTIL_GL_SHARING_ENABLE
@@ -84,59 +88,49 @@ GLuint oglCreateVBO(const void* data, int dataSize, GLenum target, GLenum usage)
 
 bool oclGetNVIDIAPlatform(cl_platform_id* clSelectedPlatformID)
 {
-	char chBuffer[1024];
-	cl_uint num_platforms;
-	cl_platform_id* clPlatformIDs;
-	cl_int error;
 	*clSelectedPlatformID = NULL;
-	cl_uint i = 0;
 
-	// Get OpenCL platform count
-	error = clGetPlatformIDs (0, NULL, &num_platforms);
-	if ( !oclHandleErrorMessage("Getting platforms",error) )
+	const oclRegistry* registry = oclGetRegistry();
+	if(registry->error != CL_SUCCESS)
 		return false;
-	
+
+	const cl_uint num_platforms = (cl_uint)registry->platforms.size();
 	if(num_platforms == 0)
 	{
 		printf("No OpenCL platform was found!\n");
 		return false;
 	}
-	else
+
+	// trap the NVIDIA platform if found
+	printf("Available platforms:\n");
+	for(cl_uint i = 0; i < num_platforms; ++i)
 	{
-		// if there's a platform or more, make space for ID's
-		if ((clPlatformIDs = (cl_platform_id*)malloc(num_platforms * sizeof(cl_platform_id))) == NULL)
+		const std::string& name = registry->platforms[i].name;
+		printf("Platform %d: %s\n", i, name.c_str());
+		if(name.find("NVIDIA") != std::string::npos)
 		{
-			printf("Failed to allocate memory for cl_platform ID's!\n");
-			return false;
+			printf("Selected platform %d\n", i);
+			*clSelectedPlatformID = registry->platforms[i].platform;
+			break;
 		}
+	}
 
-		// get platform info for each platform and trap the NVIDIA platform if found
-		error = clGetPlatformIDs (num_platforms, clPlatformIDs, NULL);
-		printf("Available platforms:\n");
-		for(i = 0; i < num_platforms; ++i)
+	// default to the platform of the best ranked device if NVIDIA not found
+	if(*clSelectedPlatformID == NULL)
+	{
+		std::vector<oclDeviceCandidate> ranked;
+		if( oclRankDevices(&ranked) )
 		{
-			error = clGetPlatformInfo (clPlatformIDs[i], CL_PLATFORM_NAME, 1024, &chBuffer, NULL);
-			if(error == CL_SUCCESS)
-			{
-				printf("Platform %d: %s\n", i, chBuffer);
-				if(strstr(chBuffer, "NVIDIA") != NULL)
-				{
-					printf("Selected platform %d\n", i);
-					*clSelectedPlatformID = clPlatformIDs[i];
-					break;
-				}
-			}
+			printf("Could not find a nvidia platform.\n Defaulting to platform of best ranked device.\n");
+			printf("selected platform: %u\n", ranked[0].platformIndex);
+			*clSelectedPlatformID = ranked[0].platform;
 		}
-
-		// default to first platform if NVIDIA not found
-		if(*clSelectedPlatformID == NULL)
+		else
 		{
 			printf("Could not find a nvidia platform.\n Defaulting to first found platform.\n");
 			printf("selected platform: %d\n", 0);
-			*clSelectedPlatformID = clPlatformIDs[0];
+			*clSelectedPlatformID = registry->platforms[0].platform;
 		}
-
-		free(clPlatformIDs);
 	}
 
 	return true;
@@ -144,52 +138,50 @@ bool oclGetNVIDIAPlatform(cl_platform_id* clSelectedPlatformID)
 
 bool oclGetSomeGPUDevice(cl_device_id* deviceId , cl_platform_id platformId)
 {
-	cl_uint deviceCount;
-	cl_int error;
-	cl_device_id* devices;
-
-	// Get number of devices
-	error = clGetDeviceIDs(platformId,CL_DEVICE_TYPE_GPU,0, NULL, &deviceCount);
-	if( !oclHandleErrorMessage("Fetching GPU device count",error) ) return false;
+	const std::vector<cl_device_id> devices = oclGetRegistry()->devices(platformId, CL_DEVICE_TYPE_GPU);
+	const cl_uint deviceCount = (cl_uint)devices.size();
 
 	if(deviceCount == 0)
 	{
 		printf("No GPU devices found on system\n");
+#ifdef OCL_UTIL_GL_SHARING_ENABLE
 		return false;
+#else
+		// Fall back to the best ranked CPU/accelerator device on this platform.
+		std::vector<oclDeviceCandidate> ranked;
+		if( !oclRankDevices(&ranked) )
+			return false;
+		for(size_t i = 0; i < ranked.size(); i++)
+		{
+			if(ranked[i].platform == platformId)
+			{
+				printf("Falling back to device %u: %s\n", ranked[i].deviceIndex, ranked[i].info->name.c_str());
+				*deviceId = ranked[i].device;
+				return true;
+			}
+		}
+		return false;
+#endif
 	}
 
-	// Get list of devices
-	devices = (cl_device_id*)malloc(deviceCount*sizeof(cl_device_id));
-	error = clGetDeviceIDs(platformId,CL_DEVICE_TYPE_GPU, deviceCount, devices, NULL);
-	if( !oclHandleErrorMessage("Geting list of GPU devices",error) ) return false;
-
 #ifdef OCL_UTIL_GL_SHARING_ENABLE
 	// Search for device that supports context sharing.
 	bool foundDevice = false;
 	int deviceIndex;
-	for(int i = 0; i < deviceCount; i++)
+	for(cl_uint i = 0; i < deviceCount; i++)
 	{
-		size_t extensionsSize;
-
-		// Get size of extensions
-		error = clGetDeviceInfo(devices[i], CL_DEVICE_EXTENSIONS, 0, NULL, &extensionsSize);
-		if( !oclHandleErrorMessage("Getting device extensions count",error) ) return false;
-
-		// Get extensions
-		char* extensions = (char*)malloc(extensionsSize);
-		error = clGetDeviceInfo(devices[i], CL_DEVICE_EXTENSIONS, extensionsSize, extensions, NULL);
-		if( !oclHandleErrorMessage("Getting device extensions",error) ) { free(extensions); continue;}
+		const oclDeviceInfo* info = oclGetDeviceInfo(devices[i]);
+		if(info == NULL)
+			continue;
 
 		// Check if the extensions contains the GL_SHARING_EXTENSION
-		if( strstr(extensions,GL_SHARING_EXTENSION) != NULL )
+		if( info->hasExtension(GL_SHARING_EXTENSION) )
 		{
 			printf("Device %d supports \"%s\".\n",i,GL_SHARING_EXTENSION);
 			foundDevice = true;
 			deviceIndex = i;
-			free(extensions);
 			break;
 		}
-		free(extensions);
 	}
 
 	if(!foundDevice)
@@ -204,7 +196,6 @@ bool oclGetSomeGPUDevice(cl_device_id* deviceId , cl_platform_id platformId)
 	*deviceId = devices[0];
 #endif
 
-	free(devices);
 	return true;
 }
 
@@ -286,13 +277,13 @@ const char* oclErrorString(cl_int error)
 		"CL_IMAGE_FORMAT_NOT_SUPPORTED",
 		"CL_BUILD_PROGRAM_FAILURE",
 		"CL_MAP_FAILURE",
-		"",
-		"",
-		"",
-		"",
-		"",
-		"",
-		"",
+		"CL_MISALIGNED_SUB_BUFFER_OFFSET",
+		"CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST",
+		"CL_COMPILE_PROGRAM_FAILURE",
+		"CL_LINKER_NOT_AVAILABLE",
+		"CL_LINK_PROGRAM_FAILURE",
+		"CL_DEVICE_PARTITION_FAILED",
+		"CL_KERNEL_ARG_INFO_NOT_AVAILABLE",
 		"",
 		"",
 		"",
@@ -337,30 +328,121 @@ const char* oclErrorString(cl_int error)
 		"CL_INVALID_BUFFER_SIZE",
 		"CL_INVALID_MIP_LEVEL",
 		"CL_INVALID_GLOBAL_WORK_SIZE",
+		"CL_INVALID_PROPERTY",
+		"CL_INVALID_IMAGE_DESCRIPTOR",
+		"CL_INVALID_COMPILER_OPTIONS",
+		"CL_INVALID_LINKER_OPTIONS",
+		"CL_INVALID_DEVICE_PARTITION_COUNT",
 	};
 
 	const int errorCount = sizeof(errorString) / sizeof(errorString[0]);
 
 	const int index = -error;
 
-	return (index >= 0 && index < errorCount) ? errorString[index] : "";
-}
+	if(index >= 0 && index < errorCount)
+		return errorString[index];
 
-bool oclHandleErrorMessage(const char* action, cl_int error)
-{
-	printf(action);
-	printf("...\t");
-	if(error == CL_SUCCESS)
+	// Extension error codes
+	switch(error)
 	{
-		printf("OK\n");
-		return true;
+	case -1000: return "CL_INVALID_GL_SHAREGROUP_REFERENCE_KHR";
+	case -1001: return "CL_PLATFORM_NOT_FOUND_KHR";
+	default: return "";
 	}
-	else
+}
+
+struct oclErrorRing
+{
+	oclErrorRecord records[OCL_UTIL_ERROR_RING_SIZE];
+	cl_ulong count;
+};
+
+// Each thread only ever touches its own ring, so recording needs no locks.
+static thread_local oclErrorRing oclThreadErrors;
+
+#ifdef OCL_UTIL_THROW_ON_ERROR
+static std::atomic<bool> oclThrowOnError(true);
+#else
+static std::atomic<bool> oclThrowOnError(false);
+#endif
+static std::atomic<int> oclVerbosity(OCL_UTIL_VERBOSITY);
+
+oclException::oclException(const char* action, cl_int error)
+	: std::runtime_error(std::string(action) + ": " + oclErrorString(error))
+	, m_error(error)
+{
+}
+
+bool oclReportError(const char* action, cl_int error)
+{
+	oclErrorRecord& record = oclThreadErrors.records[oclThreadErrors.count % OCL_UTIL_ERROR_RING_SIZE];
+	strncpy(record.action, action, sizeof(record.action) - 1);
+	record.action[sizeof(record.action) - 1] = '\0';
+	record.code = error;
+	record.message = oclErrorString(error);
+	record.timestamp = (cl_ulong)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	oclThreadErrors.count++;
+
+#if OCL_UTIL_VERBOSITY >= 1
+	if(oclVerbosity.load(std::memory_order_relaxed) >= 1)
 	{
-		printf("FAIL\n");
-		printf("Error code %d : %s\n", error, oclErrorString(error));
-		return false;
+		printf("%s...\tFAIL\n", action);
+		printf("Error code %d : %s\n", error, record.message);
 	}
+#endif
+
+	if( oclThrowOnError.load(std::memory_order_relaxed) )
+		throw oclException(action, error);
+	return false;
+}
+
+void oclReportSuccess(const char* action)
+{
+	if(oclVerbosity.load(std::memory_order_relaxed) >= 2)
+		printf("%s...\tOK\n", action);
+}
+
+void oclSetVerbosity(int level)
+{
+	oclVerbosity = level < OCL_UTIL_VERBOSITY ? level : OCL_UTIL_VERBOSITY;
+}
+
+int oclGetVerbosity()
+{
+	return oclVerbosity;
+}
+
+void oclSetThrowOnError(bool enable)
+{
+	oclThrowOnError = enable;
+}
+
+size_t oclGetErrorRecords(oclErrorRecord* records, size_t maxRecords)
+{
+	const cl_ulong count = oclThreadErrors.count;
+	size_t available = count < OCL_UTIL_ERROR_RING_SIZE ? (size_t)count : OCL_UTIL_ERROR_RING_SIZE;
+	if(maxRecords < available)
+		available = maxRecords;
+
+	for(size_t i = 0; i < available; i++)
+		records[i] = oclThreadErrors.records[(count - 1 - i) % OCL_UTIL_ERROR_RING_SIZE];
+	return available;
+}
+
+bool oclGetLastError(oclErrorRecord* record)
+{
+	return oclGetErrorRecords(record, 1) == 1;
+}
+
+cl_ulong oclGetErrorCount()
+{
+	return oclThreadErrors.count;
+}
+
+void oclClearErrors()
+{
+	oclThreadErrors.count = 0;
 }
 
 void oclPrintPlatformInfo(cl_platform_id id)
@@ -402,136 +484,60 @@ void oclPrintPlatformInfo(cl_platform_id id)
 
 void oclPrintDeviceInfo(cl_device_id device)
 {
-	char device_string[1024];
-	bool nv_device_attibute_query = false;
-
-	// CL_DEVICE_NAME
-	clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(device_string), &device_string, NULL);
-	printf( "  CL_DEVICE_NAME: \t\t\t%s\n", device_string);
-
-	// CL_DEVICE_VENDOR
-	clGetDeviceInfo(device, CL_DEVICE_VENDOR, sizeof(device_string), &device_string, NULL);
-	printf( "  CL_DEVICE_VENDOR: \t\t\t%s\n", device_string);
-
-	// CL_DRIVER_VERSION
-	clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(device_string), &device_string, NULL);
-	printf( "  CL_DRIVER_VERSION: \t\t\t%s\n", device_string);
+	const oclDeviceInfo* info = oclGetDeviceInfo(device);
+	if(info == NULL)
+	{
+		printf("Unable to query device info\n");
+		return;
+	}
 
-	// CL_DEVICE_VERSION
-	clGetDeviceInfo(device, CL_DEVICE_VERSION, sizeof(device_string), &device_string, NULL);
-	printf( "  CL_DEVICE_VERSION: \t\t\t%s\n", device_string);
+	printf( "  CL_DEVICE_NAME: \t\t\t%s\n", info->name.c_str());
+	printf( "  CL_DEVICE_VENDOR: \t\t\t%s\n", info->vendor.c_str());
+	printf( "  CL_DRIVER_VERSION: \t\t\t%s\n", info->driverVersion.c_str());
+	printf( "  CL_DEVICE_VERSION: \t\t\t%s\n", info->deviceVersion.c_str());
 
-#if !defined(__APPLE__) && !defined(__MACOSX)
 	// CL_DEVICE_OPENCL_C_VERSION (if CL_DEVICE_VERSION version > 1.0)
-	if(strncmp("OpenCL 1.0", device_string, 10) != 0) 
-	{
-		// This code is unused for devices reporting OpenCL 1.0, but a def is needed anyway to allow compilation using v 1.0 headers 
-		// This constant isn't #defined in 1.0
-#ifndef CL_DEVICE_OPENCL_C_VERSION
-#define CL_DEVICE_OPENCL_C_VERSION 0x103D   
-#endif
-
-		clGetDeviceInfo(device, CL_DEVICE_OPENCL_C_VERSION, sizeof(device_string), &device_string, NULL);
-		printf( "  CL_DEVICE_OPENCL_C_VERSION: \t\t%s\n", device_string);
-	}
-#endif
+	if( !info->openclCVersion.empty() )
+		printf( "  CL_DEVICE_OPENCL_C_VERSION: \t\t%s\n", info->openclCVersion.c_str());
 
 	// CL_DEVICE_TYPE
-	cl_device_type type;
-	clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
-	if( type & CL_DEVICE_TYPE_CPU )
+	if( info->type & CL_DEVICE_TYPE_CPU )
 		printf( "  CL_DEVICE_TYPE:\t\t\t%s\n", "CL_DEVICE_TYPE_CPU");
-	if( type & CL_DEVICE_TYPE_GPU )
+	if( info->type & CL_DEVICE_TYPE_GPU )
 		printf( "  CL_DEVICE_TYPE:\t\t\t%s\n", "CL_DEVICE_TYPE_GPU");
-	if( type & CL_DEVICE_TYPE_ACCELERATOR )
+	if( info->type & CL_DEVICE_TYPE_ACCELERATOR )
 		printf( "  CL_DEVICE_TYPE:\t\t\t%s\n", "CL_DEVICE_TYPE_ACCELERATOR");
-	if( type & CL_DEVICE_TYPE_DEFAULT )
+	if( info->type & CL_DEVICE_TYPE_DEFAULT )
 		printf( "  CL_DEVICE_TYPE:\t\t\t%s\n", "CL_DEVICE_TYPE_DEFAULT");
 
-	// CL_DEVICE_MAX_COMPUTE_UNITS
-	cl_uint compute_units;
-	clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(compute_units), &compute_units, NULL);
-	printf( "  CL_DEVICE_MAX_COMPUTE_UNITS:\t\t%u\n", compute_units);
-
-	// CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS
-	size_t workitem_dims;
-	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, sizeof(workitem_dims), &workitem_dims, NULL);
-	printf( "  CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS:\t%u\n", workitem_dims);
-
-	// CL_DEVICE_MAX_WORK_ITEM_SIZES
-	size_t workitem_size[3];
-	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(workitem_size), &workitem_size, NULL);
-	printf( "  CL_DEVICE_MAX_WORK_ITEM_SIZES:\t%u / %u / %u \n", workitem_size[0], workitem_size[1], workitem_size[2]);
-
-	// CL_DEVICE_MAX_WORK_GROUP_SIZE
-	size_t workgroup_size;
-	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(workgroup_size), &workgroup_size, NULL);
-	printf( "  CL_DEVICE_MAX_WORK_GROUP_SIZE:\t%u\n", workgroup_size);
-
-	// CL_DEVICE_MAX_CLOCK_FREQUENCY
-	cl_uint clock_frequency;
-	clGetDeviceInfo(device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(clock_frequency), &clock_frequency, NULL);
-	printf( "  CL_DEVICE_MAX_CLOCK_FREQUENCY:\t%u MHz\n", clock_frequency);
-
-	// CL_DEVICE_ADDRESS_BITS
-	cl_uint addr_bits;
-	clGetDeviceInfo(device, CL_DEVICE_ADDRESS_BITS, sizeof(addr_bits), &addr_bits, NULL);
-	printf( "  CL_DEVICE_ADDRESS_BITS:\t\t%u\n", addr_bits);
-
-	// CL_DEVICE_MAX_MEM_ALLOC_SIZE
-	cl_ulong max_mem_alloc_size;
-	clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_mem_alloc_size), &max_mem_alloc_size, NULL);
-	printf( "  CL_DEVICE_MAX_MEM_ALLOC_SIZE:\t\t%u MByte\n", (unsigned int)(max_mem_alloc_size / (1024 * 1024)));
-
-	// CL_DEVICE_GLOBAL_MEM_SIZE
-	cl_ulong mem_size;
-	clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(mem_size), &mem_size, NULL);
-	printf( "  CL_DEVICE_GLOBAL_MEM_SIZE:\t\t%u MByte\n", (unsigned int)(mem_size / (1024 * 1024)));
-
-	// CL_DEVICE_ERROR_CORRECTION_SUPPORT
-	cl_bool error_correction_support;
-	clGetDeviceInfo(device, CL_DEVICE_ERROR_CORRECTION_SUPPORT, sizeof(error_correction_support), &error_correction_support, NULL);
-	printf( "  CL_DEVICE_ERROR_CORRECTION_SUPPORT:\t%s\n", error_correction_support == CL_TRUE ? "yes" : "no");
-
-	// CL_DEVICE_LOCAL_MEM_TYPE
-	cl_device_local_mem_type local_mem_type;
-	clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_TYPE, sizeof(local_mem_type), &local_mem_type, NULL);
-	printf( "  CL_DEVICE_LOCAL_MEM_TYPE:\t\t%s\n", local_mem_type == 1 ? "local" : "global");
-
-	// CL_DEVICE_LOCAL_MEM_SIZE
-	clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(mem_size), &mem_size, NULL);
-	printf( "  CL_DEVICE_LOCAL_MEM_SIZE:\t\t%u KByte\n", (unsigned int)(mem_size / 1024));
-
-	// CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE
-	clGetDeviceInfo(device, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, sizeof(mem_size), &mem_size, NULL);
-	printf( "  CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE:\t%u KByte\n", (unsigned int)(mem_size / 1024));
+	printf( "  CL_DEVICE_MAX_COMPUTE_UNITS:\t\t%u\n", info->computeUnits);
+	printf( "  CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS:\t%u\n", info->maxWorkItemDimensions);
+	printf( "  CL_DEVICE_MAX_WORK_ITEM_SIZES:\t%u / %u / %u \n",
+		(unsigned int)info->maxWorkItemSizes[0], (unsigned int)info->maxWorkItemSizes[1], (unsigned int)info->maxWorkItemSizes[2]);
+	printf( "  CL_DEVICE_MAX_WORK_GROUP_SIZE:\t%u\n", (unsigned int)info->maxWorkGroupSize);
+	printf( "  CL_DEVICE_MAX_CLOCK_FREQUENCY:\t%u MHz\n", info->maxClockFrequency);
+	printf( "  CL_DEVICE_ADDRESS_BITS:\t\t%u\n", info->addressBits);
+	printf( "  CL_DEVICE_MAX_MEM_ALLOC_SIZE:\t\t%u MByte\n", (unsigned int)(info->maxMemAllocSize / (1024 * 1024)));
+	printf( "  CL_DEVICE_GLOBAL_MEM_SIZE:\t\t%u MByte\n", (unsigned int)(info->globalMemSize / (1024 * 1024)));
+	printf( "  CL_DEVICE_ERROR_CORRECTION_SUPPORT:\t%s\n", info->errorCorrectionSupport == CL_TRUE ? "yes" : "no");
+	if( info->versionAtLeast(1, 1) )
+		printf( "  CL_DEVICE_HOST_UNIFIED_MEMORY:\t\t%s\n", info->hostUnifiedMemory == CL_TRUE ? "yes" : "no");
+	printf( "  CL_DEVICE_LOCAL_MEM_TYPE:\t\t%s\n", info->localMemType == CL_LOCAL ? "local" : "global");
+	printf( "  CL_DEVICE_LOCAL_MEM_SIZE:\t\t%u KByte\n", (unsigned int)(info->localMemSize / 1024));
+	printf( "  CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE:\t%u KByte\n", (unsigned int)(info->maxConstantBufferSize / 1024));
 
 	// CL_DEVICE_QUEUE_PROPERTIES
-	cl_command_queue_properties queue_properties;
-	clGetDeviceInfo(device, CL_DEVICE_QUEUE_PROPERTIES, sizeof(queue_properties), &queue_properties, NULL);
-	if( queue_properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE )
+	if( info->queueProperties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE )
 		printf( "  CL_DEVICE_QUEUE_PROPERTIES:\t\t%s\n", "CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE");    
-	if( queue_properties & CL_QUEUE_PROFILING_ENABLE )
+	if( info->queueProperties & CL_QUEUE_PROFILING_ENABLE )
 		printf( "  CL_DEVICE_QUEUE_PROPERTIES:\t\t%s\n", "CL_QUEUE_PROFILING_ENABLE");
 
-	// CL_DEVICE_IMAGE_SUPPORT
-	cl_bool image_support;
-	clGetDeviceInfo(device, CL_DEVICE_IMAGE_SUPPORT, sizeof(image_support), &image_support, NULL);
-	printf( "  CL_DEVICE_IMAGE_SUPPORT:\t\t%u\n", image_support);
-
-	// CL_DEVICE_MAX_READ_IMAGE_ARGS
-	cl_uint max_read_image_args;
-	clGetDeviceInfo(device, CL_DEVICE_MAX_READ_IMAGE_ARGS, sizeof(max_read_image_args), &max_read_image_args, NULL);
-	printf( "  CL_DEVICE_MAX_READ_IMAGE_ARGS:\t%u\n", max_read_image_args);
-
-	// CL_DEVICE_MAX_WRITE_IMAGE_ARGS
-	cl_uint max_write_image_args;
-	clGetDeviceInfo(device, CL_DEVICE_MAX_WRITE_IMAGE_ARGS, sizeof(max_write_image_args), &max_write_image_args, NULL);
-	printf( "  CL_DEVICE_MAX_WRITE_IMAGE_ARGS:\t%u\n", max_write_image_args);
+	printf( "  CL_DEVICE_IMAGE_SUPPORT:\t\t%u\n", info->imageSupport);
+	printf( "  CL_DEVICE_MAX_READ_IMAGE_ARGS:\t%u\n", info->maxReadImageArgs);
+	printf( "  CL_DEVICE_MAX_WRITE_IMAGE_ARGS:\t%u\n", info->maxWriteImageArgs);
 
 	// CL_DEVICE_SINGLE_FP_CONFIG
-	cl_device_fp_config fp_config;
-	clGetDeviceInfo(device, CL_DEVICE_SINGLE_FP_CONFIG, sizeof(cl_device_fp_config), &fp_config, NULL);
+	cl_device_fp_config fp_config = info->singleFpConfig;
 	printf( "  CL_DEVICE_SINGLE_FP_CONFIG:\t\t%s%s%s%s%s%s\n",
 		fp_config & CL_FP_DENORM ? "denorms " : "",
 		fp_config & CL_FP_INF_NAN ? "INF-quietNaNs " : "",
@@ -541,43 +547,36 @@ void oclPrintDeviceInfo(cl_device_id device)
 		fp_config & CL_FP_FMA ? "fma " : "");
 
 	// CL_DEVICE_IMAGE2D_MAX_WIDTH, CL_DEVICE_IMAGE2D_MAX_HEIGHT, CL_DEVICE_IMAGE3D_MAX_WIDTH, CL_DEVICE_IMAGE3D_MAX_HEIGHT, CL_DEVICE_IMAGE3D_MAX_DEPTH
-	size_t szMaxDims[5];
 	printf( "\n  CL_DEVICE_IMAGE <dim>"); 
-	clGetDeviceInfo(device, CL_DEVICE_IMAGE2D_MAX_WIDTH, sizeof(size_t), &szMaxDims[0], NULL);
-	printf( "\t\t\t2D_MAX_WIDTH\t %u\n", szMaxDims[0]);
-	clGetDeviceInfo(device, CL_DEVICE_IMAGE2D_MAX_HEIGHT, sizeof(size_t), &szMaxDims[1], NULL);
-	printf( "\t\t\t\t\t2D_MAX_HEIGHT\t %u\n", szMaxDims[1]);
-	clGetDeviceInfo(device, CL_DEVICE_IMAGE3D_MAX_WIDTH, sizeof(size_t), &szMaxDims[2], NULL);
-	printf( "\t\t\t\t\t3D_MAX_WIDTH\t %u\n", szMaxDims[2]);
-	clGetDeviceInfo(device, CL_DEVICE_IMAGE3D_MAX_HEIGHT, sizeof(size_t), &szMaxDims[3], NULL);
-	printf( "\t\t\t\t\t3D_MAX_HEIGHT\t %u\n", szMaxDims[3]);
-	clGetDeviceInfo(device, CL_DEVICE_IMAGE3D_MAX_DEPTH, sizeof(size_t), &szMaxDims[4], NULL);
-	printf( "\t\t\t\t\t3D_MAX_DEPTH\t %u\n", szMaxDims[4]);
-
-	// CL_DEVICE_EXTENSIONS: get device extensions, and if any then parse & log the string onto separate lines
-	clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, sizeof(device_string), &device_string, NULL);
-	if (device_string != 0) 
+	printf( "\t\t\t2D_MAX_WIDTH\t %u\n", (unsigned int)info->image2dMaxWidth);
+	printf( "\t\t\t\t\t2D_MAX_HEIGHT\t %u\n", (unsigned int)info->image2dMaxHeight);
+	printf( "\t\t\t\t\t3D_MAX_WIDTH\t %u\n", (unsigned int)info->image3dMaxWidth);
+	printf( "\t\t\t\t\t3D_MAX_HEIGHT\t %u\n", (unsigned int)info->image3dMaxHeight);
+	printf( "\t\t\t\t\t3D_MAX_DEPTH\t %u\n", (unsigned int)info->image3dMaxDepth);
+
+	// CL_DEVICE_EXTENSIONS: if any then parse & log the string onto separate lines
+	if( !info->extensions.empty() )
 	{
 		printf( "\n  CL_DEVICE_EXTENSIONS:");
-		std::string stdDevString;
-		stdDevString = std::string(device_string);
+		const std::string& stdDevString = info->extensions;
 		size_t szOldPos = 0;
-		size_t szSpacePos = stdDevString.find(' ', szOldPos); // extensions string is space delimited
-		while (szSpacePos != stdDevString.npos)
+		bool first = true;
+		while (szOldPos < stdDevString.size())
 		{
-			if( strcmp("cl_nv_device_attribute_query", stdDevString.substr(szOldPos, szSpacePos - szOldPos).c_str()) == 0 )
-				nv_device_attibute_query = true;
+			size_t szSpacePos = stdDevString.find(' ', szOldPos); // extensions string is space delimited
+			if (szSpacePos == stdDevString.npos)
+				szSpacePos = stdDevString.size();
 
-			if (szOldPos > 0)
+			if (szSpacePos > szOldPos)
 			{
-				printf( "\t\t");
+				if (!first)
+				{
+					printf( "\t\t");
+				}
+				printf( "\t\t\t%s\n", stdDevString.substr(szOldPos, szSpacePos - szOldPos).c_str());
+				first = false;
 			}
-			printf( "\t\t\t%s\n", stdDevString.substr(szOldPos, szSpacePos - szOldPos).c_str());
-
-			do {
-				szOldPos = szSpacePos + 1;
-				szSpacePos = stdDevString.find(' ', szOldPos);
-			} while (szSpacePos == szOldPos);
+			szOldPos = szSpacePos + 1;
 		}
 		printf( "\n");
 	}
@@ -588,13 +587,7 @@ void oclPrintDeviceInfo(cl_device_id device)
 
 	// CL_DEVICE_PREFERRED_VECTOR_WIDTH_<type>
 	printf( "  CL_DEVICE_PREFERRED_VECTOR_WIDTH_<t>\t"); 
-	cl_uint vec_width [6];
-	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR, sizeof(cl_uint), &vec_width[0], NULL);
-	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT, sizeof(cl_uint), &vec_width[1], NULL);
-	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT, sizeof(cl_uint), &vec_width[2], NULL);
-	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG, sizeof(cl_uint), &vec_width[3], NULL);
-	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT, sizeof(cl_uint), &vec_width[4], NULL);
-	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE, sizeof(cl_uint), &vec_width[5], NULL);
+	const cl_uint* vec_width = info->preferredVectorWidth;
 	printf( "CHAR %u, SHORT %u, INT %u, LONG %u, FLOAT %u, DOUBLE %u\n\n\n", 
 		vec_width[0], vec_width[1], vec_width[2], vec_width[3], vec_width[4], vec_width[5]); 
 }
@@ -609,15 +602,18 @@ void oclPrintBuildLog(cl_program program, cl_device_id deviceId)
 
 	// Get and print build status messages.
 	error = clGetProgramBuildInfo(program, deviceId, CL_PROGRAM_BUILD_STATUS, sizeof(cl_build_status), &build_status, NULL);
+	if( !oclHandleErrorMessage("Getting build status", error) )
+		return;
 
-	char *build_log;
-	size_t ret_val_size;
+	size_t ret_val_size = 0;
 	error = clGetProgramBuildInfo(program, deviceId, CL_PROGRAM_BUILD_LOG, 0, NULL, &ret_val_size);
+	if( !oclHandleErrorMessage("Getting build log size", error) )
+		return;
 
-	build_log = new char[ret_val_size+1];
-	error = clGetProgramBuildInfo(program, deviceId, CL_PROGRAM_BUILD_LOG, ret_val_size, build_log, NULL);
-	build_log[ret_val_size] = '\0';
-	printf("BUILD LOG: \n %s", build_log);
+	std::vector<char> build_log(ret_val_size+1, '\0');
+	error = clGetProgramBuildInfo(program, deviceId, CL_PROGRAM_BUILD_LOG, ret_val_size, &build_log[0], NULL);
+	if( !oclHandleErrorMessage("Getting build log", error) )
+		return;
 
-	delete build_log;
-}
\ No newline at end of file
+	printf("BUILD LOG: \n %s", &build_log[0]);
+}
@@ -0,0 +1,344 @@
+#include <string.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclHostAlloc.h>
+#include <oclVector.h>
+
+void oclRangeSet::add(size_t begin, size_t end, const oclRangeSet* exclude)
+{
+	if(begin >= end)
+		return;
+
+	// Merge with every range that overlaps or touches [begin, end).
+	std::vector<Range>::iterator it = m_ranges.begin();
+	while( it != m_ranges.end() && it->second < begin )
+		++it;
+	std::vector<Range>::iterator last = it;
+	while( last != m_ranges.end() && last->first <= end )
+	{
+		if(last->first < begin)
+			begin = last->first;
+		if(last->second > end)
+			end = last->second;
+		++last;
+	}
+	it = m_ranges.erase(it, last);
+	m_ranges.insert(it, Range(begin, end));
+
+	collapse(exclude);
+}
+
+void oclRangeSet::collapse(const oclRangeSet* exclude)
+{
+	// Close the smallest gaps first so the merged ranges cover as little extra as possible.
+	while( m_ranges.size() > m_maxRanges )
+	{
+		size_t best = 0;
+		for(size_t i = 1; i < m_ranges.size(); i++)
+		{
+			const size_t gapBegin = m_ranges[i - 1].second;
+			const size_t gapEnd = m_ranges[i].first;
+			if(exclude != NULL && exclude->intersects(gapBegin, gapEnd))
+				continue;
+			if(best == 0 || gapEnd - gapBegin < m_ranges[best].first - m_ranges[best - 1].second)
+				best = i;
+		}
+		if(best == 0)
+			return; // every gap holds excluded bytes
+		m_ranges[best - 1].second = m_ranges[best].second;
+		m_ranges.erase(m_ranges.begin() + best);
+	}
+}
+
+void oclRangeSet::remove(size_t begin, size_t end)
+{
+	if(begin >= end)
+		return;
+
+	std::vector<Range> kept;
+	kept.reserve(m_ranges.size() + 1);
+	for(size_t i = 0; i < m_ranges.size(); i++)
+	{
+		const Range& r = m_ranges[i];
+		if(r.second <= begin || r.first >= end)
+		{
+			kept.push_back(r);
+			continue;
+		}
+		if(r.first < begin)
+			kept.push_back(Range(r.first, begin));
+		if(r.second > end)
+			kept.push_back(Range(end, r.second));
+	}
+	m_ranges.swap(kept);
+}
+
+bool oclRangeSet::intersects(size_t begin, size_t end) const
+{
+	for(size_t i = 0; i < m_ranges.size(); i++)
+	{
+		if(m_ranges[i].first < end && m_ranges[i].second > begin)
+			return true;
+	}
+	return false;
+}
+
+oclVectorStorage::oclVectorStorage()
+	: m_flags(CL_MEM_READ_WRITE)
+	, m_host(NULL)
+	, m_hostCapacity(0)
+	, m_deviceCapacity(0)
+	, m_size(0)
+	, m_bytesUploaded(0)
+	, m_bytesDownloaded(0)
+{
+}
+
+oclVectorStorage::~oclVectorStorage()
+{
+	destroy();
+}
+
+bool oclVectorStorage::create(cl_context context, cl_command_queue queue, cl_mem_flags flags)
+{
+	destroy();
+	if(context == NULL || queue == NULL)
+		return false;
+	if( flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR) )
+		return false;
+
+	m_context = ocl::Context::retain(context);
+	m_queue = ocl::Queue::retain(queue);
+	m_flags = flags;
+	return true;
+}
+
+void oclVectorStorage::destroy()
+{
+	if(m_queue)
+		waitUploads();
+	m_buffer.reset();
+	m_queue.reset();
+	m_context.reset();
+	oclHostFree(m_host);
+
+	m_host = NULL;
+	m_hostCapacity = 0;
+	m_deviceCapacity = 0;
+	m_size = 0;
+	m_hostDirty.clear();
+	m_deviceDirty.clear();
+}
+
+void oclVectorStorage::waitUploads()
+{
+	if( m_uploads.empty() )
+		return;
+
+	clWaitForEvents((cl_uint)m_uploads.size(), &m_uploads[0]);
+	for(size_t i = 0; i < m_uploads.size(); i++)
+		clReleaseEvent(m_uploads[i]);
+	m_uploads.clear();
+}
+
+cl_int oclVectorStorage::reserve(size_t bytes)
+{
+	if(m_queue == NULL)
+		return CL_INVALID_COMMAND_QUEUE;
+	if(bytes <= m_hostCapacity)
+		return CL_SUCCESS;
+
+	waitUploads();
+	char* host = (char*)oclHostRealloc(m_host, bytes);
+	if(host == NULL)
+		return CL_OUT_OF_HOST_MEMORY;
+	m_host = host;
+	m_hostCapacity = bytes;
+
+	// Only grow the device side if it exists; otherwise it is created lazily
+	// at the full host capacity on first device access.
+	if(m_buffer != NULL)
+		return reserveDevice(bytes);
+	return CL_SUCCESS;
+}
+
+cl_int oclVectorStorage::reserveDevice(size_t bytes)
+{
+	if(bytes <= m_deviceCapacity && m_buffer != NULL)
+		return CL_SUCCESS;
+
+	cl_int error;
+	ocl::Buffer buffer(clCreateBuffer(m_context, m_flags, bytes, NULL, &error));
+	if( !oclHandleErrorMessage("Creating oclVector device buffer", error) )
+		return error;
+
+	// Carry over whatever the device holds; host dirty ranges are re-uploaded anyway.
+	const size_t keep = m_size < m_deviceCapacity ? m_size : m_deviceCapacity;
+	if(m_buffer != NULL && keep > 0)
+	{
+		error = clEnqueueCopyBuffer(m_queue, m_buffer, buffer, 0, 0, keep, 0, NULL, NULL);
+		if( !oclHandleErrorMessage("Copying oclVector device buffer", error) )
+			return error;
+	}
+	// The driver keeps the old buffer alive until the copy has finished.
+	m_buffer = std::move(buffer);
+	m_deviceCapacity = bytes;
+	return CL_SUCCESS;
+}
+
+cl_int oclVectorStorage::resize(size_t bytes, const void* fill, size_t fillSize)
+{
+	if(m_queue == NULL)
+		return CL_INVALID_COMMAND_QUEUE;
+
+	if(bytes > m_hostCapacity)
+	{
+		// Grow geometrically so repeated resizes stay amortised O(1).
+		size_t grown = m_hostCapacity + m_hostCapacity / 2;
+		cl_int error = reserve(bytes > grown ? bytes : grown);
+		if(error != CL_SUCCESS)
+			return error;
+	}
+
+	if(bytes > m_size)
+	{
+		waitUploads();
+		for(size_t pos = m_size; pos < bytes; pos += fillSize)
+			memcpy(m_host + pos, fill, fillSize < bytes - pos ? fillSize : bytes - pos);
+		m_deviceDirty.remove(m_size, bytes);
+		m_hostDirty.add(m_size, bytes, &m_deviceDirty);
+	}
+	else
+	{
+		m_hostDirty.clip(bytes);
+		m_deviceDirty.clip(bytes);
+	}
+	m_size = bytes;
+	return CL_SUCCESS;
+}
+
+cl_int oclVectorStorage::download(size_t begin, size_t end)
+{
+	// Copy out before reading since the set changes while we download.
+	std::vector<oclRangeSet::Range> ranges = m_deviceDirty.ranges();
+	for(size_t i = 0; i < ranges.size(); i++)
+	{
+		const size_t first = ranges[i].first > begin ? ranges[i].first : begin;
+		const size_t last = ranges[i].second < end ? ranges[i].second : end;
+		if(first >= last)
+			continue;
+
+		cl_int error = clEnqueueReadBuffer(m_queue, m_buffer, CL_TRUE, first, last - first, m_host + first, 0, NULL, NULL);
+		if( !oclHandleErrorMessage("Downloading oclVector range", error) )
+			return error;
+		m_deviceDirty.remove(first, last);
+		m_bytesDownloaded += last - first;
+	}
+	return CL_SUCCESS;
+}
+
+cl_int oclVectorStorage::upload()
+{
+	const std::vector<oclRangeSet::Range>& ranges = m_hostDirty.ranges();
+	for(size_t i = 0; i < ranges.size(); i++)
+	{
+		const size_t first = ranges[i].first;
+		const size_t bytes = ranges[i].second - first;
+		cl_event event;
+		cl_int error = clEnqueueWriteBuffer(m_queue, m_buffer, CL_FALSE, first, bytes, m_host + first, 0, NULL, &event);
+		if( !oclHandleErrorMessage("Uploading oclVector range", error) )
+			return error;
+		m_uploads.push_back(event);
+		m_bytesUploaded += bytes;
+	}
+	m_hostDirty.clear();
+	return CL_SUCCESS;
+}
+
+void* oclVectorStorage::host(size_t offset, size_t bytes, oclVectorAccess access, cl_int* error)
+{
+	cl_int status = CL_SUCCESS;
+	if(m_queue == NULL)
+		status = CL_INVALID_COMMAND_QUEUE;
+	else if(offset + bytes > m_size)
+		status = CL_INVALID_VALUE;
+
+	if(status == CL_SUCCESS && access != oclVectorWrite)
+		status = download(offset, offset + bytes);
+
+	if(status == CL_SUCCESS && access != oclVectorRead)
+	{
+		waitUploads();
+		m_deviceDirty.remove(offset, offset + bytes);
+		// Merging over device dirty bytes would upload stale host data on top of them.
+		m_hostDirty.add(offset, offset + bytes, &m_deviceDirty);
+	}
+
+	if(error != NULL)
+		*error = status;
+	return status == CL_SUCCESS ? m_host + offset : NULL;
+}
+
+cl_mem oclVectorStorage::device(oclVectorAccess access, cl_int* error)
+{
+	cl_int status = CL_SUCCESS;
+	if(m_queue == NULL)
+		status = CL_INVALID_COMMAND_QUEUE;
+	else if(m_hostCapacity == 0)
+		status = reserve(1); // a kernel argument needs some buffer even when empty
+	if(status == CL_SUCCESS)
+		status = reserveDevice(m_hostCapacity);
+
+	if(status == CL_SUCCESS)
+	{
+		if(access == oclVectorWrite)
+			m_hostDirty.clear();
+		else
+			status = upload();
+	}
+
+	if(status == CL_SUCCESS && access != oclVectorRead)
+	{
+		m_hostDirty.clear();
+		m_deviceDirty.clear();
+		m_deviceDirty.add(0, m_size);
+	}
+
+	if(error != NULL)
+		*error = status;
+	return status == CL_SUCCESS ? m_buffer.get() : NULL;
+}
+
+cl_mem oclVectorStorage::device(size_t offset, size_t bytes, cl_int* error)
+{
+	cl_int status;
+	cl_mem buffer = device(oclVectorRead, &status);
+	if(status == CL_SUCCESS)
+	{
+		if(offset + bytes > m_size)
+			status = CL_INVALID_VALUE;
+		else
+			m_deviceDirty.add(offset, offset + bytes, &m_hostDirty);
+	}
+
+	if(error != NULL)
+		*error = status;
+	return status == CL_SUCCESS ? buffer : NULL;
+}
+
+cl_int oclVectorStorage::syncHost()
+{
+	if(m_queue == NULL)
+		return CL_INVALID_COMMAND_QUEUE;
+	return download(0, m_size);
+}
+
+cl_int oclVectorStorage::syncDevice()
+{
+	cl_int error;
+	device(oclVectorRead, &error);
+	if(error == CL_SUCCESS)
+		waitUploads();
+	return error;
+}
@@ -0,0 +1,16 @@
+#ifndef OCL_WINDOWS_H
+#define OCL_WINDOWS_H
+
+// Internal <windows.h> include without the min/max macros and rarely used APIs.
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+#include <CL/cl.h>
+#include <oclBufferPool.h>
+#include "oclTest.h"
+
+static void testSmallRequests()
+{
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(0) == 256);
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(1) == 256);
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(256) == 256);
+}
+
+// Classes alternate between 2^k and 1.5 * 2^k.
+static void testClasses()
+{
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(257) == 384);
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(384) == 384);
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(385) == 512);
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(1000) == 1024);
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(1025) == 1536);
+	OCL_TEST_CHECK(oclBufferPool::sizeClass((size_t)3 << 20) == ((size_t)3 << 20));
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(((size_t)3 << 20) + 1) == ((size_t)4 << 20));
+}
+
+// Every request fits its class, wastes at most half of it and lands on a
+// class boundary, so equal classes can share buffers.
+static void testBounds()
+{
+	for(size_t size = 1; size < ((size_t)1 << 20); size = size * 5 / 4 + 1)
+	{
+		const size_t rounded = oclBufferPool::sizeClass(size);
+		OCL_TEST_CHECK(rounded >= size);
+		OCL_TEST_CHECK(size <= 256 || rounded - size < rounded / 2);
+		OCL_TEST_CHECK(oclBufferPool::sizeClass(rounded) == rounded);
+	}
+
+	// No overflow near the top of the range.
+	const size_t huge = (size_t)-1 - 7;
+	OCL_TEST_CHECK(oclBufferPool::sizeClass(huge) >= huge);
+}
+
+int main()
+{
+	testSmallRequests();
+	testClasses();
+	testBounds();
+	return oclTestResult("oclBufferPool");
+}
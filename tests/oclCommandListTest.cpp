@@ -0,0 +1,193 @@
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclCommandList.h>
+#include "oclTest.h"
+
+// A replay only writes kernel arguments and launches kernels. Every argument
+// in these tests is an int, recorded with its value so that skipped and
+// repeated writes show up in the call sequence.
+extern "C" CL_API_ENTRY cl_int CL_API_CALL clSetKernelArg(cl_kernel kernel, cl_uint index, size_t size,
+	const void* value)
+{
+	int argument = 0;
+	if(value != NULL && size == sizeof(argument))
+		memcpy(&argument, value, sizeof(argument));
+	oclTestRecord("arg %p %u=%d", (void*)kernel, index, argument);
+	return CL_SUCCESS;
+}
+
+extern "C" CL_API_ENTRY cl_int CL_API_CALL clEnqueueNDRangeKernel(cl_command_queue, cl_kernel kernel, cl_uint,
+	const size_t*, const size_t*, const size_t*, cl_uint waitCount, const cl_event*, cl_event* event)
+{
+	oclTestRecord("launch %p waits=%u%s", (void*)kernel, waitCount, event != NULL ? " signal" : "");
+	return CL_SUCCESS;
+}
+
+static cl_kernel oclTestKernel(size_t id)
+{
+	return (cl_kernel)(id * 16);
+}
+
+static std::string oclTestArg(cl_kernel kernel, cl_uint index, int value)
+{
+	return oclTestFormat("arg %p %u=%d", (void*)kernel, index, value);
+}
+
+static std::string oclTestLaunch(cl_kernel kernel, cl_uint waitCount = 0, bool signal = false)
+{
+	return oclTestFormat("launch %p waits=%u%s", (void*)kernel, waitCount, signal ? " signal" : "");
+}
+
+// The same argument bound to different values around two launches must be
+// re-set before each launch on every replay.
+static void testRebindBetweenLaunches()
+{
+	const cl_kernel kernel = oclTestKernel(1);
+	const size_t global = 64;
+	const int a = 1, b = 2;
+
+	oclCommandList list;
+	OCL_TEST_CHECK(list.recordArg(kernel, 0, sizeof(a), &a) == CL_SUCCESS);
+	OCL_TEST_CHECK(list.recordKernel(kernel, 1, &global) == CL_SUCCESS);
+	OCL_TEST_CHECK(list.recordArg(kernel, 0, sizeof(b), &b) == CL_SUCCESS);
+	OCL_TEST_CHECK(list.recordKernel(kernel, 1, &global) == CL_SUCCESS);
+
+	for(int frame = 0; frame < 2; frame++)
+	{
+		oclTestCalls.clear();
+		OCL_TEST_CHECK(list.replay(NULL) == CL_SUCCESS);
+		OCL_TEST_CHECK(oclTestCalls.size() == 4);
+		if(oclTestCalls.size() != 4)
+			continue;
+		OCL_TEST_CHECK(oclTestCalls[0] == oclTestArg(kernel, 0, a));
+		OCL_TEST_CHECK(oclTestCalls[1] == oclTestLaunch(kernel));
+		OCL_TEST_CHECK(oclTestCalls[2] == oclTestArg(kernel, 0, b));
+		OCL_TEST_CHECK(oclTestCalls[3] == oclTestLaunch(kernel));
+	}
+}
+
+// Arguments that already hold their value are not set again.
+static void testUnchangedArgsAreSkipped()
+{
+	const cl_kernel kernel = oclTestKernel(2);
+	const size_t global = 64;
+	const int constant = 7;
+
+	oclCommandList list;
+	const int scale = list.parameter("scale", sizeof(int));
+	list.recordArg(kernel, 0, sizeof(constant), &constant);
+	list.recordArgParameter(kernel, 1, scale);
+	list.recordKernel(kernel, 1, &global);
+
+	list.set(scale, 3);
+	oclTestCalls.clear();
+	list.replay(NULL);
+	OCL_TEST_CHECK(oclTestCalls.size() == 2);
+	OCL_TEST_CHECK(!oclTestCalls.empty() && oclTestCalls[0] == oclTestArg(kernel, 1, 3));
+
+	// Same value again: only the launch.
+	list.set(scale, 3);
+	oclTestCalls.clear();
+	list.replay(NULL);
+	OCL_TEST_CHECK(oclTestCalls.size() == 1);
+
+	list.set(scale, 4);
+	oclTestCalls.clear();
+	list.replay(NULL);
+	OCL_TEST_CHECK(oclTestCalls.size() == 2);
+	OCL_TEST_CHECK(!oclTestCalls.empty() && oclTestCalls[0] == oclTestArg(kernel, 1, 4));
+
+	// After invalidate() everything is set again, in recorded order.
+	list.invalidate();
+	oclTestCalls.clear();
+	list.replay(NULL);
+	OCL_TEST_CHECK(oclTestCalls.size() == 3);
+	if(oclTestCalls.size() == 3)
+	{
+		OCL_TEST_CHECK(oclTestCalls[0] == oclTestArg(kernel, 0, constant));
+		OCL_TEST_CHECK(oclTestCalls[1] == oclTestArg(kernel, 1, 4));
+		OCL_TEST_CHECK(oclTestCalls[2] == oclTestLaunch(kernel));
+	}
+}
+
+// The wait list goes to the first launch and the event to the last one, even
+// with argument writes before and after them.
+static void testWaitListAndEvent()
+{
+	const cl_kernel first = oclTestKernel(3);
+	const cl_kernel second = oclTestKernel(4);
+	const size_t global = 64;
+	const int value = 5;
+
+	oclCommandList list;
+	list.recordArg(first, 0, sizeof(value), &value);
+	list.recordKernel(first, 1, &global);
+	list.recordKernel(second, 1, &global);
+	list.recordArg(second, 0, sizeof(value), &value);
+
+	cl_event wait = (cl_event)0x10;
+	cl_event done = NULL;
+	list.invalidate();
+	oclTestCalls.clear();
+	list.replay(NULL, 1, &wait, &done);
+	OCL_TEST_CHECK(oclTestCalls.size() == 4);
+	if(oclTestCalls.size() == 4)
+	{
+		OCL_TEST_CHECK(oclTestCalls[1] == oclTestLaunch(first, 1));
+		OCL_TEST_CHECK(oclTestCalls[2] == oclTestLaunch(second, 0, true));
+	}
+}
+
+// A launch after a parameter binding must not fall back to the constant the
+// argument held before, so replay refuses to run until the parameter is set.
+static void testUnsetParameter()
+{
+	const cl_kernel kernel = oclTestKernel(5);
+	const size_t global = 64;
+	const int x = 9;
+
+	oclCommandList list;
+	const int p = list.parameter("p", sizeof(int));
+	list.recordArg(kernel, 1, sizeof(x), &x);
+	list.recordKernel(kernel, 1, &global);
+	list.recordArgParameter(kernel, 1, p);
+	list.recordKernel(kernel, 1, &global);
+
+	oclTestCalls.clear();
+	OCL_TEST_CHECK(list.replay(NULL) == CL_INVALID_KERNEL_ARGS);
+	OCL_TEST_CHECK(oclTestCalls.empty());
+
+	list.set(p, 11);
+	oclTestCalls.clear();
+	OCL_TEST_CHECK(list.replay(NULL) == CL_SUCCESS);
+	// x is still set from recording, so only the parameter write is issued.
+	OCL_TEST_CHECK(oclTestCalls.size() == 3);
+	if(oclTestCalls.size() == 3)
+		OCL_TEST_CHECK(oclTestCalls[1] == oclTestArg(kernel, 1, 11));
+}
+
+static void testParameterRedeclaration()
+{
+	oclCommandList list;
+	const int scale = list.parameter("scale", sizeof(int));
+	OCL_TEST_CHECK(scale >= 0);
+	OCL_TEST_CHECK(list.parameter("scale", sizeof(int)) == scale);
+	OCL_TEST_CHECK(list.parameter("scale", sizeof(double)) == -1);
+	OCL_TEST_CHECK(list.parameter("empty", 0) == -1);
+	OCL_TEST_CHECK(list.parameterCount() == 1);
+}
+
+int main()
+{
+	oclSetVerbosity(0);
+	testParameterRedeclaration();
+	testUnsetParameter();
+	testRebindBetweenLaunches();
+	testUnchangedArgsAreSkipped();
+	testWaitListAndEvent();
+	return oclTestResult("oclCommandList");
+}
@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include "oclTest.h"
+
+static void testErrorStrings()
+{
+	OCL_TEST_CHECK(strcmp(oclErrorString(CL_SUCCESS), "CL_SUCCESS") == 0);
+	OCL_TEST_CHECK(strcmp(oclErrorString(CL_OUT_OF_RESOURCES), "CL_OUT_OF_RESOURCES") == 0);
+	OCL_TEST_CHECK(strcmp(oclErrorString(CL_INVALID_VALUE), "CL_INVALID_VALUE") == 0);
+	OCL_TEST_CHECK(strcmp(oclErrorString(CL_INVALID_GLOBAL_WORK_SIZE), "CL_INVALID_GLOBAL_WORK_SIZE") == 0);
+	OCL_TEST_CHECK(strcmp(oclErrorString(-1001), "CL_PLATFORM_NOT_FOUND_KHR") == 0);
+
+	// Unused codes and positive values have no name.
+	OCL_TEST_CHECK(strcmp(oclErrorString(-20), "") == 0);
+	OCL_TEST_CHECK(strcmp(oclErrorString(-9999), "") == 0);
+	OCL_TEST_CHECK(strcmp(oclErrorString(1), "") == 0);
+}
+
+static void testErrorRing()
+{
+	oclSetThrowOnError(false);
+	oclClearErrors();
+
+	OCL_TEST_CHECK(oclHandleErrorMessage("Succeeding", CL_SUCCESS));
+	OCL_TEST_CHECK(oclGetErrorCount() == 0);
+	oclErrorRecord record;
+	OCL_TEST_CHECK(!oclGetLastError(&record));
+
+	const int failures = OCL_UTIL_ERROR_RING_SIZE + 8;
+	for(int i = 0; i < failures; i++)
+		OCL_TEST_CHECK(!oclHandleErrorMessage(i % 2 ? "Odd failure" : "Even failure", CL_INVALID_VALUE - i % 2));
+	OCL_TEST_CHECK(oclGetErrorCount() == (cl_ulong)failures);
+
+	// Newest first, and only the last OCL_UTIL_ERROR_RING_SIZE are kept.
+	oclErrorRecord records[OCL_UTIL_ERROR_RING_SIZE + 4];
+	OCL_TEST_CHECK(oclGetErrorRecords(records, OCL_UTIL_ERROR_RING_SIZE + 4) == OCL_UTIL_ERROR_RING_SIZE);
+	OCL_TEST_CHECK(strcmp(records[0].action, "Odd failure") == 0);
+	OCL_TEST_CHECK(records[0].code == CL_INVALID_VALUE - 1);
+	OCL_TEST_CHECK(strcmp(records[0].message, oclErrorString(CL_INVALID_VALUE - 1)) == 0);
+	OCL_TEST_CHECK(strcmp(records[1].action, "Even failure") == 0);
+	OCL_TEST_CHECK(records[1].timestamp <= records[0].timestamp);
+
+	// Long actions are truncated, not overrun.
+	char action[200];
+	memset(action, 'x', sizeof(action) - 1);
+	action[sizeof(action) - 1] = '\0';
+	oclHandleErrorMessage(action, CL_INVALID_KERNEL);
+	OCL_TEST_CHECK(oclGetLastError(&record));
+	OCL_TEST_CHECK(strlen(record.action) == sizeof(record.action) - 1);
+
+	oclClearErrors();
+	OCL_TEST_CHECK(oclGetErrorCount() == 0);
+}
+
+static void testThrowOnError()
+{
+	oclSetThrowOnError(true);
+	bool thrown = false;
+	try
+	{
+		oclHandleErrorMessage("Throwing", CL_INVALID_CONTEXT);
+	}
+	catch(const oclException& exception)
+	{
+		thrown = exception.error() == CL_INVALID_CONTEXT;
+	}
+	OCL_TEST_CHECK(thrown);
+	// Success never throws.
+	OCL_TEST_CHECK(oclHandleErrorMessage("Succeeding", CL_SUCCESS));
+	oclSetThrowOnError(false);
+	oclClearErrors();
+}
+
+int main()
+{
+	oclSetVerbosity(0);
+	testErrorStrings();
+	testErrorRing();
+	testThrowOnError();
+	return oclTestResult("oclError");
+}
@@ -0,0 +1,43 @@
+#include <CL/cl.h>
+#include <oclImagePool.h>
+#include "oclTest.h"
+
+static size_t oclTestFormatSize(cl_channel_order order, cl_channel_type type)
+{
+	cl_image_format format;
+	format.image_channel_order = order;
+	format.image_channel_data_type = type;
+	return oclImageFormatSize(format);
+}
+
+static void testChannelSizes()
+{
+	OCL_TEST_CHECK(oclTestFormatSize(CL_R, CL_UNORM_INT8) == 1);
+	OCL_TEST_CHECK(oclTestFormatSize(CL_RG, CL_HALF_FLOAT) == 4);
+	OCL_TEST_CHECK(oclTestFormatSize(CL_RGBA, CL_UNORM_INT8) == 4);
+	OCL_TEST_CHECK(oclTestFormatSize(CL_BGRA, CL_SIGNED_INT16) == 8);
+	OCL_TEST_CHECK(oclTestFormatSize(CL_RGBA, CL_FLOAT) == 16);
+	OCL_TEST_CHECK(oclTestFormatSize(CL_INTENSITY, CL_UNSIGNED_INT32) == 4);
+}
+
+// Packed types describe the whole pixel, whatever the order.
+static void testPackedTypes()
+{
+	OCL_TEST_CHECK(oclTestFormatSize(CL_RGB, CL_UNORM_SHORT_565) == 2);
+	OCL_TEST_CHECK(oclTestFormatSize(CL_RGB, CL_UNORM_SHORT_555) == 2);
+	OCL_TEST_CHECK(oclTestFormatSize(CL_RGB, CL_UNORM_INT_101010) == 4);
+}
+
+static void testUnknownFormats()
+{
+	OCL_TEST_CHECK(oclTestFormatSize(0, CL_FLOAT) == 0);
+	OCL_TEST_CHECK(oclTestFormatSize(CL_RGBA, 0) == 0);
+}
+
+int main()
+{
+	testChannelSizes();
+	testPackedTypes();
+	testUnknownFormats();
+	return oclTestResult("oclImageFormat");
+}
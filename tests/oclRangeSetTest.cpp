@@ -0,0 +1,104 @@
+#include <CL/cl.h>
+#include <oclVector.h>
+#include "oclTest.h"
+
+static bool oclTestDisjoint(const oclRangeSet& a, const oclRangeSet& b)
+{
+	for(size_t i = 0; i < a.ranges().size(); i++)
+	{
+		if( b.intersects(a.ranges()[i].first, a.ranges()[i].second) )
+			return false;
+	}
+	return true;
+}
+
+static void testAddMerges()
+{
+	oclRangeSet set;
+	set.add(10, 20);
+	set.add(30, 40);
+	set.add(20, 30); // touches both neighbours
+	OCL_TEST_CHECK(set.ranges().size() == 1);
+	OCL_TEST_CHECK(set.ranges()[0] == oclRangeSet::Range(10, 40));
+
+	set.add(5, 5); // empty
+	OCL_TEST_CHECK(set.ranges().size() == 1);
+	OCL_TEST_CHECK(set.intersects(39, 50));
+	OCL_TEST_CHECK(!set.intersects(40, 50));
+}
+
+static void testRemoveSplits()
+{
+	oclRangeSet set;
+	set.add(0, 100);
+	set.remove(40, 60);
+	OCL_TEST_CHECK(set.ranges().size() == 2);
+	OCL_TEST_CHECK(set.ranges()[0] == oclRangeSet::Range(0, 40));
+	OCL_TEST_CHECK(set.ranges()[1] == oclRangeSet::Range(60, 100));
+
+	set.clip(80);
+	OCL_TEST_CHECK(set.ranges().back() == oclRangeSet::Range(60, 80));
+	set.clear();
+	OCL_TEST_CHECK(set.empty());
+}
+
+static void testCollapseClosesSmallestGap()
+{
+	oclRangeSet set(2);
+	set.add(0, 10);
+	set.add(100, 110);
+	set.add(112, 120); // gap of 2 to the previous range, 90 to the first
+	OCL_TEST_CHECK(set.ranges().size() == 2);
+	OCL_TEST_CHECK(set.ranges()[0] == oclRangeSet::Range(0, 10));
+	OCL_TEST_CHECK(set.ranges()[1] == oclRangeSet::Range(100, 120));
+}
+
+static void testCollapseKeepsExcludedGaps()
+{
+	oclRangeSet exclude;
+	exclude.add(10, 20);
+
+	oclRangeSet set(1);
+	set.add(0, 10, &exclude);
+	set.add(20, 30, &exclude);
+	// The only gap is excluded, so the limit is exceeded rather than covering it.
+	OCL_TEST_CHECK(set.ranges().size() == 2);
+	OCL_TEST_CHECK(!set.intersects(10, 20));
+}
+
+// A kernel writes the whole buffer, then the host overwrites more separate
+// ranges than the set can track, the way oclVectorStorage::host does it for
+// oclVectorWrite. No host dirty range may cover bytes the device still owns,
+// or the next upload would overwrite the kernel's results with stale data.
+static void testHostWritesAfterKernel()
+{
+	const size_t size = 1000;
+	oclRangeSet hostDirty;
+	oclRangeSet deviceDirty;
+	deviceDirty.add(0, size);
+
+	for(size_t i = 0; i < 17; i++)
+	{
+		const size_t begin = i * 50;
+		deviceDirty.remove(begin, begin + 10);
+		hostDirty.add(begin, begin + 10, &deviceDirty);
+		OCL_TEST_CHECK(oclTestDisjoint(hostDirty, deviceDirty));
+	}
+	for(size_t i = 0; i < 17; i++)
+		OCL_TEST_CHECK(hostDirty.intersects(i * 50, i * 50 + 10));
+
+	// Once the device side is downloaded, the host ranges may merge again.
+	deviceDirty.clear();
+	hostDirty.add(900, 910, &deviceDirty);
+	OCL_TEST_CHECK(hostDirty.ranges().size() <= 16);
+}
+
+int main()
+{
+	testAddMerges();
+	testRemoveSplits();
+	testCollapseClosesSmallestGap();
+	testCollapseKeepsExcludedGaps();
+	testHostWritesAfterKernel();
+	return oclTestResult("oclRangeSet");
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclSourceBundle.h>
+#include "oclTest.h"
+
+// Sources are written to the working directory and removed again.
+static const char* oclTestFiles[] = {
+	"oclBundleTest_main.cl",
+	"oclBundleTest_once.h",
+	"oclBundleTest_angled.h",
+	"oclBundleTest_loopA.h",
+	"oclBundleTest_loopB.h"
+};
+
+static void oclTestWrite(const char* path, const char* text)
+{
+	FILE* file = fopen(path, "wb");
+	if(file == NULL)
+		return;
+	fputs(text, file);
+	fclose(file);
+}
+
+static size_t oclTestCount(const std::string& text, const std::string& word)
+{
+	size_t count = 0;
+	for(size_t at = text.find(word); at != std::string::npos; at = text.find(word, at + 1))
+		count++;
+	return count;
+}
+
+static void testExpansion()
+{
+	oclTestWrite("oclBundleTest_once.h", "#pragma once\nint onceValue;\n");
+	oclTestWrite("oclBundleTest_angled.h", "int angledValue;\n");
+	oclTestWrite("oclBundleTest_loopA.h", "int commentedValue;\n");
+	oclTestWrite("oclBundleTest_main.cl",
+		"#include \"oclBundleTest_once.h\"\n"
+		"  #  include \"oclBundleTest_once.h\"\n"
+		"#include <oclBundleTest_angled.h>\n"
+		"/* #include \"oclBundleTest_loopA.h\"\n"
+		"#include \"oclBundleTest_loopA.h\" */\n"
+		"// #include \"oclBundleTest_loopA.h\"\n"
+		"#include \"oclBundleTest_missing.h\"\n"
+		"__kernel void k() {}\n");
+
+	std::vector<std::string> includePaths(1, ".");
+	oclSourceBundle bundle;
+	OCL_TEST_CHECK(oclBundleProgramSource("oclBundleTest_main.cl", includePaths, &bundle));
+
+	// #pragma once files are expanded once; commented out includes are not expanded.
+	OCL_TEST_CHECK(oclTestCount(bundle.source, "int onceValue;") == 1);
+	OCL_TEST_CHECK(oclTestCount(bundle.source, "int angledValue;") == 1);
+	OCL_TEST_CHECK(oclTestCount(bundle.source, "#include \"oclBundleTest_loopA.h\"") == 3);
+	OCL_TEST_CHECK(oclTestCount(bundle.source, "int commentedValue;") == 0);
+	// Unresolved includes are left for the compiler.
+	OCL_TEST_CHECK(oclTestCount(bundle.source, "#include \"oclBundleTest_missing.h\"") == 1);
+	OCL_TEST_CHECK(oclTestCount(bundle.source, "__kernel void k() {}") == 1);
+	OCL_TEST_CHECK(oclTestCount(bundle.source, "#line 4 \"") == 1);
+
+	OCL_TEST_CHECK(bundle.dependencies.size() == 3);
+	if(bundle.dependencies.size() == 3)
+	{
+		OCL_TEST_CHECK(bundle.dependencies[0].path.find("oclBundleTest_main.cl") != std::string::npos);
+		OCL_TEST_CHECK(bundle.dependencies[0].includes.size() == 2);
+	}
+	OCL_TEST_CHECK(!oclSourceBundleIsStale(&bundle));
+
+	// Rewriting with the same content is not a change.
+	const cl_ulong hash = bundle.hash;
+	oclTestWrite("oclBundleTest_angled.h", "int angledValue;\n");
+	OCL_TEST_CHECK(!oclSourceBundleIsStale(&bundle));
+
+	oclTestWrite("oclBundleTest_angled.h", "int angledValue, changed;\n");
+	OCL_TEST_CHECK(oclSourceBundleIsStale(&bundle));
+	OCL_TEST_CHECK(oclRefreshSourceBundle("oclBundleTest_main.cl", includePaths, &bundle));
+	OCL_TEST_CHECK(bundle.hash != hash);
+	OCL_TEST_CHECK(oclTestCount(bundle.source, "int angledValue, changed;") == 1);
+}
+
+static void testCircularInclude()
+{
+	oclTestWrite("oclBundleTest_loopA.h", "#include \"oclBundleTest_loopB.h\"\n");
+	oclTestWrite("oclBundleTest_loopB.h", "#include \"oclBundleTest_loopA.h\"\n");
+
+	oclSourceBundle bundle;
+	OCL_TEST_CHECK(!oclBundleProgramSource("oclBundleTest_loopA.h", std::vector<std::string>(), &bundle));
+}
+
+int main()
+{
+	// The missing and circular includes are expected.
+	oclSetVerbosity(0);
+	testExpansion();
+	testCircularInclude();
+	for(size_t i = 0; i < sizeof(oclTestFiles) / sizeof(oclTestFiles[0]); i++)
+		remove(oclTestFiles[i]);
+	return oclTestResult("oclSourceBundle");
+}
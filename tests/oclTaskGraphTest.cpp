@@ -0,0 +1,119 @@
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+#include <oclUtil.h>
+#include <oclTaskGraph.h>
+#include "oclTest.h"
+
+// The task graph sees one in-order device: queues and events are numbered
+// handles, and only kernel launches are recorded, with the queue they went to
+// and how many events they wait for.
+static size_t oclTestQueues = 0;
+static size_t oclTestEvents = 0;
+
+extern "C" {
+
+CL_API_ENTRY cl_int CL_API_CALL clGetDeviceInfo(cl_device_id, cl_device_info, size_t size, void* value,
+	size_t* sizeReturned)
+{
+	if(value != NULL)
+		memset(value, 0, size);
+	if(sizeReturned != NULL)
+		*sizeReturned = 0;
+	return CL_SUCCESS;
+}
+
+CL_API_ENTRY cl_command_queue CL_API_CALL clCreateCommandQueue(cl_context, cl_device_id,
+	cl_command_queue_properties, cl_int* error)
+{
+	if(error != NULL)
+		*error = CL_SUCCESS;
+	return (cl_command_queue)(++oclTestQueues * 16);
+}
+
+CL_API_ENTRY cl_int CL_API_CALL clRetainContext(cl_context) { return CL_SUCCESS; }
+CL_API_ENTRY cl_int CL_API_CALL clReleaseContext(cl_context) { return CL_SUCCESS; }
+CL_API_ENTRY cl_int CL_API_CALL clReleaseCommandQueue(cl_command_queue) { return CL_SUCCESS; }
+CL_API_ENTRY cl_int CL_API_CALL clReleaseEvent(cl_event) { return CL_SUCCESS; }
+CL_API_ENTRY cl_int CL_API_CALL clFlush(cl_command_queue) { return CL_SUCCESS; }
+CL_API_ENTRY cl_int CL_API_CALL clFinish(cl_command_queue) { return CL_SUCCESS; }
+CL_API_ENTRY cl_int CL_API_CALL clWaitForEvents(cl_uint, const cl_event*) { return CL_SUCCESS; }
+
+CL_API_ENTRY cl_int CL_API_CALL clEnqueueNDRangeKernel(cl_command_queue queue, cl_kernel kernel, cl_uint,
+	const size_t*, const size_t*, const size_t*, cl_uint waitCount, const cl_event*, cl_event* event)
+{
+	oclTestRecord("k%u q%u waits=%u", (unsigned int)(size_t)kernel, (unsigned int)((size_t)queue / 16 - 1), waitCount);
+	if(event != NULL)
+		*event = (cl_event)(++oclTestEvents * 16);
+	return CL_SUCCESS;
+}
+
+}
+
+static const size_t oclTestGlobal = 64;
+
+static oclTaskGraph::Nodes oclTestNodes(oclTaskGraph::Node a)
+{
+	return oclTaskGraph::Nodes(1, a);
+}
+
+static oclTaskGraph::Nodes oclTestNodes(oclTaskGraph::Node a, oclTaskGraph::Node b)
+{
+	oclTaskGraph::Nodes nodes(1, a);
+	nodes.push_back(b);
+	return nodes;
+}
+
+// A diamond k0 -> {k1, k2} -> k3 plus a host callback after k0: device work
+// goes first, the second branch gets its own queue, the join waits for both.
+static void testDiamond()
+{
+	oclTaskGraph graph;
+	OCL_TEST_CHECK(graph.create((cl_context)16, (cl_device_id)16, 2));
+	OCL_TEST_CHECK(graph.queueCount() == 2);
+
+	const oclTaskGraph::Node k0 = graph.addKernel((cl_kernel)0, 1, &oclTestGlobal);
+	graph.addHost([] { oclTestCalls.push_back("host"); }, oclTestNodes(k0));
+	const oclTaskGraph::Node k1 = graph.addKernel((cl_kernel)1, 1, &oclTestGlobal, NULL, oclTestNodes(k0));
+	const oclTaskGraph::Node k2 = graph.addKernel((cl_kernel)2, 1, &oclTestGlobal, NULL, oclTestNodes(k0));
+	graph.addKernel((cl_kernel)3, 1, &oclTestGlobal, NULL, oclTestNodes(k1, k2));
+
+	oclTestCalls.clear();
+	OCL_TEST_CHECK(graph.execute() == CL_SUCCESS);
+	OCL_TEST_CHECK(oclTestCalls.size() == 5);
+	if(oclTestCalls.size() == 5)
+	{
+		OCL_TEST_CHECK(oclTestCalls[0] == "k0 q0 waits=0");
+		OCL_TEST_CHECK(oclTestCalls[1] == "k1 q0 waits=1");
+		OCL_TEST_CHECK(oclTestCalls[2] == "k2 q1 waits=1");
+		OCL_TEST_CHECK(oclTestCalls[3] == "k3 q0 waits=2");
+		OCL_TEST_CHECK(oclTestCalls[4] == "host");
+	}
+}
+
+static void testCycle()
+{
+	oclTaskGraph graph;
+	OCL_TEST_CHECK(graph.create((cl_context)16, (cl_device_id)16, 1));
+
+	const oclTaskGraph::Node k0 = graph.addKernel((cl_kernel)0, 1, &oclTestGlobal);
+	const oclTaskGraph::Node k1 = graph.addKernel((cl_kernel)1, 1, &oclTestGlobal, NULL, oclTestNodes(k0));
+	graph.addDependency(k0, k1);
+	// Self dependencies and unknown nodes are ignored rather than recorded.
+	graph.addDependency(k1, k1);
+	graph.addDependency(k1, 7);
+
+	oclTestCalls.clear();
+	OCL_TEST_CHECK(graph.execute() == CL_INVALID_VALUE);
+	OCL_TEST_CHECK(oclTestCalls.empty());
+}
+
+int main()
+{
+	oclSetVerbosity(0);
+	testDiamond();
+	testCycle();
+	return oclTestResult("oclTaskGraph");
+}
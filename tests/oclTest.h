@@ -0,0 +1,64 @@
+#ifndef OCL_TEST_H
+#define OCL_TEST_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Minimal checks for the standalone test programs in tests/. None of them
+// needs an OpenCL device.
+static int oclTestFailures = 0;
+
+#define OCL_TEST_CHECK(condition) \
+	do { \
+		if( !(condition) ) \
+		{ \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			oclTestFailures++; \
+		} \
+	} while(0)
+
+static int oclTestResult(const char* name)
+{
+	if(oclTestFailures == 0)
+		printf("%s: passed\n", name);
+	else
+		printf("%s: %d check(s) failed\n", name, oclTestFailures);
+	return oclTestFailures == 0 ? 0 : 1;
+}
+
+// Tests of components that drive OpenCL define the entry points they reach
+// themselves, as extern "C" functions with the OpenCL signatures. Definitions
+// in the executable take precedence over the OpenCL library's, so the calls
+// land in these stubs. The stubs describe each call as a string with
+// oclTestRecord and the test compares oclTestCalls with the expected sequence.
+static std::vector<std::string> oclTestCalls;
+
+static inline std::string oclTestFormatV(const char* format, va_list args)
+{
+	char call[128];
+	vsnprintf(call, sizeof(call), format, args);
+	return call;
+}
+
+// printf-style description of a call, for building expected sequences.
+static inline std::string oclTestFormat(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::string call = oclTestFormatV(format, args);
+	va_end(args);
+	return call;
+}
+
+// Appends a printf-style description of a call to oclTestCalls.
+static inline void oclTestRecord(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	oclTestCalls.push_back(oclTestFormatV(format, args));
+	va_end(args);
+}
+
+#endif